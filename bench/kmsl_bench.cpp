@@ -0,0 +1,447 @@
+// kmsl_bench: the lexer, the parser and the interpreter on generated scripts, with the null input backend
+//
+// kmsl_bench                                 runs everything, writes kmsl_bench.json
+// kmsl_bench --filter interpreter            only the cases whose name contains "interpreter"
+// kmsl_bench --compare baseline.json         compares the medians with a saved run, exit code 1 on a regression
+//                                            a case which fails (wrong results of the scripts) gives exit code 1 too
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <regex>
+#include <map>
+#include <stdexcept>
+
+#include <boost/program_options.hpp>
+
+#include "lexer/Lexer.hpp"
+#include "parser/Parser.hpp"
+#include "interpreter/Interpreter.hpp"
+#include "interpreter/InstancePool.hpp"
+#include "error/ErrorHandler.hpp"
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	struct Case
+	{
+		std::string name;
+		size_t bytes; // size of the script
+		std::function<void()> setup; // before every run, not timed
+		std::function<void()> run; // throws std::runtime_error when the result is wrong
+		std::string series = ""; // lexer sizes: a run too long for the budget is skipped by the growth of the series
+	};
+
+	struct Result
+	{
+		std::string name;
+		size_t bytes = 0;
+		size_t runs = 0;
+		double median_ms = 0;
+		double p99_ms = 0;
+		bool skipped = false;
+		double projected_s = 0; // of a skipped case
+		std::string error; // of a failed case
+	};
+
+	struct Series // the last two sizes of the lexer series and their medians
+	{
+		size_t bytes[2] = { 0, 0 };
+		double ms[2] = { 0, 0 };
+		size_t count = 0;
+	};
+
+	struct Options
+	{
+		double budget = 1.0; // seconds per case
+		size_t min_runs = 5;
+		size_t max_runs = 1000;
+		double max_case = 30.0; // seconds a single run may be expected to take
+	};
+
+	/* SCRIPTS */
+
+	// a bit of everything the lexer knows, repeated up to the size
+	std::string lexerScript(size_t bytes)
+	{
+		const std::string block =
+			"x = 42 + y * 3.5 # a comment\n"
+			"IF (x >= 10 && name != \"text\")\n"
+			"{\n"
+			"\tPRINT 'value: ' + x\n"
+			"\tMOVE 100, 200, 0.5\n"
+			"}\n"
+			"FOR (i = 0, i < 10, i++) { n += i ** 2 }\n";
+
+		std::string script;
+		script.reserve(bytes + block.size());
+		while (script.size() < bytes)
+			script += block;
+		script.resize(bytes);
+		script += '\n';
+		return script;
+	}
+
+	std::string nestedBlocks(size_t depth)
+	{
+		std::string script = "a = 0\n";
+		for (size_t i = 0; i < depth; i++)
+			script += "IF (a < 1)\n{\n";
+		script += "a = a + 1\n";
+		for (size_t i = 0; i < depth; i++)
+			script += "}\n";
+		return script;
+	}
+
+	std::string nestedParentheses(size_t depth)
+	{
+		return "x = " + std::string(depth, '(') + "1 + 2" + std::string(depth, ')') + "\n";
+	}
+
+	std::string loop(size_t iterations, const std::string& before, const std::string& body)
+	{
+		return before + "FOR (i = 0, i < " + std::to_string(iterations) + ", i++)\n{\n" + body + "}\n";
+	}
+
+	/* CASES */
+
+	std::vector<Case> makeCases()
+	{
+		std::vector<Case> cases;
+
+		for (size_t bytes : { 1u << 10, 16u << 10, 256u << 10, 4u << 20, 50u << 20 })
+		{
+			auto script = std::make_shared<std::string>();
+			std::string size = bytes >= (1u << 20) ? std::to_string(bytes >> 20) + "MB" : std::to_string(bytes >> 10) + "KB";
+
+			cases.push_back(Case{ "lexer/" + size, bytes,
+				[script, bytes]() { if (script->empty()) *script = lexerScript(bytes); },
+				[script]() { kmsl::Lexer lexer(*script); lexer.scanTokens(); },
+				"lexer" });
+		}
+
+		auto addParser = [&](const std::string& name, const std::string& script)
+		{
+			auto tokens = std::make_shared<std::vector<kmsl::Token>>();
+			cases.push_back(Case{ "parser/" + name, script.size(),
+				[tokens, script]() { if (tokens->empty()) *tokens = kmsl::Lexer(script).scanTokens(); },
+				[tokens]()
+				{
+					kmsl::ErrorHandler error_handler;
+					kmsl::Parser parser(*tokens, error_handler);
+					parser.parse();
+				} });
+		};
+
+		addParser("blocks_10", nestedBlocks(10));
+		addParser("blocks_100", nestedBlocks(100));
+		addParser("blocks_500", nestedBlocks(500));
+		addParser("parentheses_100", nestedParentheses(100));
+		addParser("parentheses_1000", nestedParentheses(1000));
+
+		// the script is lexed, parsed and checked before every run, only execute() is timed
+		auto addInterpreter = [&](const std::string& name, const std::string& script)
+		{
+			auto interpreter = std::make_shared<std::unique_ptr<kmsl::Interpreter>>();
+			cases.push_back(Case{ "interpreter/" + name, script.size(),
+				[interpreter, script]()
+				{
+					interpreter->reset(); // the previous one is destroyed outside the timing too
+					*interpreter = std::make_unique<kmsl::Interpreter>();
+					(*interpreter)->setCode(script);
+				},
+				[interpreter]() { (*interpreter)->execute(); } });
+		};
+
+		addInterpreter("arithmetic", loop(20000, "n = 0\n", "\tn = n + i * 3 % 7 - 1\n"));
+		addInterpreter("float_arithmetic", loop(20000, "f = 0.5\n", "\tf = f * 1.0001 + i / 3.0\n"));
+		addInterpreter("string_building", loop(5000, "s = ''\n", "\ts = s + 'ab'\n"));
+		addInterpreter("scopes", loop(5000, "",
+			"\ta = i\n"
+			"\tb = a + 1\n"
+			"\tc = b + a\n"
+			"\td = c * 2\n"
+			"\tIF (d > 0)\n"
+			"\t{\n"
+			"\t\tf = d - a\n"
+			"\t\tg = f + b\n"
+			"\t}\n"));
+		addInterpreter("do_calls", loop(200, "", "\tDO \"q = 1 + 2\"\n"));
+		addInterpreter("compound_assignment", loop(500, "n = 0\n", "\tn += i\n\tn -= 1\n\tn *= 1\n"));
+		addInterpreter("input_null_backend", loop(5000, "", "\tMOVE i, i\n\tPRESS 'a'\n\tSCROLL 1\n"));
+
+		// one compiled program in 10000 interpreters on at least 4 threads, a wrong result is a runtime error
+		std::string instance = loop(20, "n = 0\n", "\tn += i\n\tr = RANDOM\n\tPRESS 'a', 0\n") +
+			"s = 'ab' * 3\n"
+			"IF ((n != 190) || (s != 'ababab'))\n"
+			"{\n"
+			"\tn = 1 / 0\n"
+			"}\n";
+		auto program = std::make_shared<std::shared_ptr<const kmsl::Program>>();
+		cases.push_back(Case{ "concurrency/10000_instances", instance.size(),
+			[program, instance]() { if (!*program) *program = kmsl::Program::compile(instance); },
+			[program]()
+			{
+				kmsl::InstancePool pool(std::max(4u, std::thread::hardware_concurrency()));
+				pool.submit(*program, 10000);
+				if (size_t failed = pool.wait())
+					throw std::runtime_error(std::to_string(failed) + " of 10000 instances failed");
+			} });
+
+		return cases;
+	}
+
+	/* RUNNING */
+
+	double percentile(std::vector<double> samples, double p)
+	{
+		std::sort(samples.begin(), samples.end());
+		size_t rank = static_cast<size_t>(std::ceil(p * samples.size()));
+		return samples[std::min(samples.size(), std::max<size_t>(rank, 1)) - 1];
+	}
+
+	double median(std::vector<double> samples)
+	{
+		std::sort(samples.begin(), samples.end());
+		size_t n = samples.size();
+		return n % 2 ? samples[n / 2] : (samples[n / 2 - 1] + samples[n / 2]) / 2;
+	}
+
+	Result runCase(const Case& c, const Options& options, std::map<std::string, Series>& all_series)
+	{
+		Result result;
+		result.name = c.name;
+		result.bytes = c.bytes;
+
+		// the growth between the last two sizes of a series tells how long this one would take,
+		// after the first size it is assumed to be quadratic
+		Series* series = c.series.empty() ? nullptr : &all_series[c.series];
+		if (series && series->count > 0)
+		{
+			double exponent = 2;
+			if (series->count >= 2 && series->ms[0] > 0)
+				exponent = std::max(1.0, std::log(series->ms[1] / series->ms[0]) / std::log(double(series->bytes[1]) / series->bytes[0]));
+			double projected = series->ms[1] / 1000 * std::pow(double(c.bytes) / series->bytes[1], exponent);
+
+			if (projected > options.max_case)
+			{
+				result.skipped = true;
+				result.projected_s = projected;
+				return result;
+			}
+		}
+
+		std::vector<double> samples;
+		c.setup(); // the first one generates the script, which is not part of the budget
+		auto start = Clock::now();
+
+		while (samples.size() < options.max_runs &&
+			(samples.size() < options.min_runs || std::chrono::duration<double>(Clock::now() - start).count() < options.budget))
+		{
+			if (!samples.empty())
+				c.setup();
+
+			auto begin = Clock::now();
+			try
+			{
+				c.run();
+			}
+			catch (const std::runtime_error& e)
+			{
+				result.error = e.what(); // a wrong result is not timed any further
+				break;
+			}
+			samples.push_back(std::chrono::duration<double, std::milli>(Clock::now() - begin).count());
+
+			// one run longer than the whole budget is enough
+			if (samples.size() == 1 && samples[0] / 1000 > options.budget)
+				break;
+		}
+
+		result.runs = samples.size();
+		if (!result.error.empty())
+			return result;
+		result.median_ms = median(samples);
+		result.p99_ms = percentile(samples, 0.99);
+
+		if (series)
+		{
+			series->bytes[0] = series->bytes[1];
+			series->ms[0] = series->ms[1];
+			series->bytes[1] = c.bytes;
+			series->ms[1] = result.median_ms;
+			series->count++;
+		}
+		return result;
+	}
+
+	/* OUTPUT */
+
+	// one case per line, so --compare can read it back without a JSON library
+	void writeJson(std::ostream& os, const std::vector<Result>& results)
+	{
+#ifdef NDEBUG
+		const char* build = "release";
+#else
+		const char* build = "debug";
+#endif
+		os << "{\n  \"build\": \"" << build << "\",\n  \"cases\": [\n";
+		for (size_t i = 0; i < results.size(); i++)
+		{
+			const Result& r = results[i];
+			os << "    {\"name\": \"" << r.name << "\", \"bytes\": " << r.bytes;
+			if (!r.error.empty())
+				os << ", \"failed\": true";
+			else if (r.skipped)
+				os << ", \"skipped\": true, \"projected_s\": " << std::fixed << std::setprecision(1) << r.projected_s;
+			else
+				os << ", \"runs\": " << r.runs << std::fixed << std::setprecision(4) << ", \"median_ms\": " << r.median_ms << ", \"p99_ms\": " << r.p99_ms;
+			os << '}' << (i + 1 < results.size() ? "," : "") << '\n';
+		}
+		os << "  ]\n}\n";
+	}
+
+	std::map<std::string, double> readMedians(const std::string& path)
+	{
+		std::map<std::string, double> medians;
+		std::ifstream file(path);
+		std::regex pattern("\"name\": \"([^\"]+)\".*\"median_ms\": ([0-9.eE+-]+)");
+
+		std::string line;
+		std::smatch match;
+		while (std::getline(file, line))
+			if (std::regex_search(line, match, pattern))
+				medians[match[1]] = std::stod(match[2]);
+
+		return medians;
+	}
+
+	void printResult(const Result& r)
+	{
+		std::cout << std::left << std::setw(34) << r.name << std::right;
+		if (!r.error.empty())
+			std::cout << "FAILED: " << r.error << std::endl;
+		else if (r.skipped)
+			std::cout << "skipped, one run would take ~" << std::fixed << std::setprecision(0) << r.projected_s << " s" << std::endl;
+		else
+		{
+			std::cout << std::fixed << std::setprecision(3) << std::setw(12) << r.median_ms << " ms" << std::setw(12) << r.p99_ms << " ms p99"
+				<< std::setw(7) << r.runs << " runs";
+			if (r.bytes > (1u << 16) && r.median_ms > 0)
+				std::cout << std::setprecision(2) << std::setw(10) << r.bytes / 1048576.0 / (r.median_ms / 1000) << " MB/s";
+			std::cout << std::endl;
+		}
+	}
+
+	// false if a case got slower than the threshold
+	bool compare(const std::vector<Result>& results, const std::map<std::string, double>& baseline, double threshold)
+	{
+		bool ok = true;
+		std::cout << std::endl << "compared with the baseline (threshold " << std::fixed << std::setprecision(0) << threshold * 100 << "%):" << std::endl;
+
+		for (const Result& r : results)
+		{
+			auto it = baseline.find(r.name);
+			if (r.skipped || !r.error.empty() || it == baseline.end() || it->second <= 0)
+				continue;
+
+			double change = r.median_ms / it->second - 1;
+			std::cout << std::left << std::setw(34) << r.name << std::right << std::fixed << std::setprecision(3)
+				<< std::setw(12) << it->second << " ms ->" << std::setw(12) << r.median_ms << " ms" << std::showpos << std::setprecision(1)
+				<< std::setw(9) << change * 100 << '%' << std::noshowpos;
+
+			if (change > threshold)
+			{
+				std::cout << "  REGRESSION";
+				ok = false;
+			}
+			else if (change < -threshold)
+				std::cout << "  faster";
+			std::cout << std::endl;
+		}
+		return ok;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	namespace po = boost::program_options;
+	po::options_description desc("Allowed options");
+	Options options;
+
+	desc.add_options()
+		("help,h", "Show help message")
+		("filter", po::value<std::string>(), "Run only the cases whose name contains the text")
+		("out", po::value<std::string>()->default_value("kmsl_bench.json"), "File for the JSON results")
+		("compare", po::value<std::string>(), "JSON results of an earlier run to compare with")
+		("threshold", po::value<double>()->default_value(0.10), "Slowdown of the median which counts as a regression")
+		("budget", po::value<double>(&options.budget)->default_value(1.0), "Seconds of runs per case")
+		("min-runs", po::value<size_t>(&options.min_runs)->default_value(5), "Runs per case at least")
+		("max-case", po::value<double>(&options.max_case)->default_value(30.0), "Skip a case whose single run is expected to take longer (seconds)");
+
+	po::variables_map vm;
+	try
+	{
+		po::store(po::parse_command_line(argc, argv, desc), vm);
+		po::notify(vm);
+	}
+	catch (po::error& e)
+	{
+		std::cerr << "Error: " << e.what() << "\n";
+		return 1;
+	}
+
+	if (vm.count("help"))
+	{
+		std::cout << desc << std::endl;
+		return 0;
+	}
+
+	std::map<std::string, double> baseline;
+	if (vm.count("compare"))
+	{
+		baseline = readMedians(vm["compare"].as<std::string>());
+		if (baseline.empty())
+		{
+			std::cerr << "Error: no results in " << vm["compare"].as<std::string>() << "\n";
+			return 1;
+		}
+	}
+
+	std::string filter = vm.count("filter") ? vm["filter"].as<std::string>() : "";
+	std::vector<Result> results;
+	std::map<std::string, Series> series;
+	bool failed = false;
+
+	for (const Case& c : makeCases())
+	{
+		if (c.name.find(filter) == std::string::npos)
+			continue;
+
+		results.push_back(runCase(c, options, series));
+		printResult(results.back());
+		failed = failed || !results.back().error.empty();
+	}
+
+	std::string outpath = vm["out"].as<std::string>();
+	std::ofstream out(outpath);
+	if (!out.is_open())
+	{
+		std::cerr << "Error: can not open " << outpath << "\n";
+		return 1;
+	}
+	writeJson(out, results);
+
+	if (!baseline.empty() && !compare(results, baseline, vm["threshold"].as<double>()))
+		return 1;
+	return failed ? 1 : 0;
+}
@@ -2,14 +2,22 @@
 
 #include <string>
 #include <memory>
+#include <atomic>
 
 namespace kmsl
 {
 	class AstNode
 	{
 	public:
+		AstNode() { created_.fetch_add(1, std::memory_order_relaxed); }
+		AstNode(const AstNode&) { created_.fetch_add(1, std::memory_order_relaxed); }
 		virtual ~AstNode() {}
 		virtual std::string toString() const { return "Base Class"; }
 		virtual std::unique_ptr<AstNode> clone() const { return std::make_unique<AstNode>(); };
+
+		static unsigned long long created() { return created_.load(std::memory_order_relaxed); } // for --stats
+
+	private:
+		inline static std::atomic<unsigned long long> created_{ 0 };
 	};
 }
\ No newline at end of file
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <memory>
+
+#include "AstNode.hpp"
+#include "../token/Token.hpp"
+
+namespace kmsl
+{
+    class AsyncNode : public AstNode // ASYNC <MOVE|DMOVE|SCROLL|TYPE|PRESS ...> or ASYNC <COPY|WRITEFILE|REMOVE ...>
+    {
+    public:
+        AsyncNode(Token t, std::unique_ptr<AstNode> stmt)
+            : token(t), statement(std::move(stmt)) {}
+
+        std::string toString() const override
+        {
+            return "Async(" + (statement ? statement->toString() : "null") + ")";
+        }
+
+        std::unique_ptr<AstNode> clone() const override
+        {
+            return std::unique_ptr<AsyncNode>(std::make_unique<AsyncNode>(token, statement ? statement->clone() : nullptr));
+        }
+
+        Token token;
+        std::unique_ptr<AstNode> statement; // runs on the input dispatcher thread, file operations on the file job pool
+    };
+}
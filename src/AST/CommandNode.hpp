@@ -7,7 +7,7 @@
 
 namespace kmsl
 {
-    class CommandNode : public AstNode // single token node: break, continue, !!
+    class CommandNode : public AstNode // single token node: break, continue, !!, sync, flush
     {
     public:
         CommandNode(Token t) : type(t) {}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <sstream>
+
+#include "AstNode.hpp"
+#include "../token/Token.hpp"
+
+namespace kmsl
+{
+    class ExecNode : public AstNode // EXEC 'program', 'arg', ... [, timeout]
+    {
+    public:
+        ExecNode(Token t, std::vector<std::unique_ptr<AstNode>> arguments)
+            : token(t), argumentNodes(std::move(arguments)) {}
+
+        std::string toString() const override
+        {
+            std::ostringstream oss;
+            oss << "Exec(";
+
+            for (size_t i = 0; i < argumentNodes.size(); ++i)
+            {
+                oss << argumentNodes[i]->toString();
+                if (i < argumentNodes.size() - 1)
+                    oss << ", ";
+            }
+
+            oss << ")";
+            return oss.str();
+        }
+
+        std::unique_ptr<AstNode> clone() const override
+        {
+            std::vector<std::unique_ptr<AstNode>> nodes;
+            nodes.reserve(argumentNodes.size());
+
+            for (const auto& a : argumentNodes)
+                nodes.push_back(a->clone());
+
+            return std::make_unique<ExecNode>(token, std::move(nodes));
+        }
+
+        Token token;
+        std::vector<std::unique_ptr<AstNode>> argumentNodes; // program and arguments are strings, a number at the end is the timeout
+    };
+}
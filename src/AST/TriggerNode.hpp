@@ -0,0 +1,30 @@
+#pragma once
+
+#include <memory>
+
+#include "AstNode.hpp"
+#include "../token/Token.hpp"
+
+namespace kmsl
+{
+    class TriggerNode : public AstNode // ON KEY <key> { } or EVERY <seconds> { }
+    {
+    public:
+        TriggerNode(Token t, std::unique_ptr<AstNode> argument, std::unique_ptr<AstNode> body)
+            : token(t), argumentNode(std::move(argument)), bodyNode(std::move(body)) {}
+
+        std::string toString() const override
+        {
+            return std::string(token.type == TokenType::ON ? "OnKey" : "Every") + "(\n  Argument: " + (argumentNode ? argumentNode->toString() : "null") + ",\n  Body: " + (bodyNode ? bodyNode->toString() : "null") + "\n)";
+        }
+
+        std::unique_ptr<AstNode> clone() const override
+        {
+            return std::unique_ptr<TriggerNode>(std::make_unique<TriggerNode>(token, argumentNode ? argumentNode->clone() : nullptr, bodyNode ? bodyNode->clone() : nullptr));
+        }
+
+        Token token; // ON or EVERY
+        std::unique_ptr<AstNode> argumentNode; // key name or interval
+        std::unique_ptr<AstNode> bodyNode; // runs by the event loop
+    };
+}
@@ -11,4 +11,7 @@
 #include "WhileNode.hpp"
 #include "MouseNode.hpp"
 #include "KeyNode.hpp"
-#include "CommandNode.hpp"
\ No newline at end of file
+#include "CommandNode.hpp"
+#include "AsyncNode.hpp"
+#include "TriggerNode.hpp"
+#include "ExecNode.hpp"
\ No newline at end of file
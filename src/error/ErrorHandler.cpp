@@ -1,5 +1,14 @@
 #include "ErrorHandler.hpp"
 
+void kmsl::ErrorHandler::report(const Error& error)
+{
+	errors_.emplace_back(error);
+	Metrics::add(Metrics::Counter::ERRORS);
+
+	if (Trace::enabled()) // --trace: an instant event at the time of the error
+		Trace::instant("error", stringifyErrorType(error.type), error.message, getLineByPosition(error.pos));
+}
+
 void kmsl::ErrorHandler::showErrors()
 {
 	std::cerr << std::endl << std::to_string(getErrorsCount()) << " error/-s was found..." << std::endl;
@@ -72,5 +81,5 @@ int kmsl::ErrorHandler::getLineByPosition(long long pos)
 		line_number++;
 	}
 
-	return line_number + 1;
+	return line_number + first_line_;
 }
@@ -7,6 +7,8 @@
 #include <cmath>
 
 #include "../token/Token.hpp"
+#include "../io/Trace.hpp"
+#include "../io/Metrics.hpp"
 
 namespace kmsl
 {
@@ -33,8 +35,10 @@ namespace kmsl
 		ErrorHandler() {}
 
 		void setCode(const std::string& c) { code_ = c; }
-		void report(const Error& error) { errors_.emplace_back(error); }
-		void report(ErrorType t, const std::string& msg, long long p) { errors_.emplace_back(t, msg, p); }
+		void setFirstLine(int line) { first_line_ = line; } // the code starts at this line of the script (kmsl -)
+		int getFirstLine() const { return first_line_; }
+		void report(const Error& error);
+		void report(ErrorType t, const std::string& msg, long long p) { report(Error(t, msg, p)); }
 		void clearErrors() { errors_.clear(); }
 		int getErrorsCount() { return errors_.size(); }
 
@@ -48,5 +52,6 @@ namespace kmsl
 		std::vector<Error> errors_;
 		std::string code_;
 		long long error_pos_;
+		int first_line_ = 1;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,6 @@
+#include "AllocationCounter.hpp"
+
+namespace kmsl
+{
+	std::atomic<bool> AllocationCounter::installed_(false);
+}
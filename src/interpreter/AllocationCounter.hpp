@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+namespace kmsl
+{
+	// counts the heap allocations of the calling thread through the global operator new, which is only
+	// replaced in the KMSL executable (AllocationHooks.cpp), a program embedding kmsl_core keeps its own
+	// a thread counts while one of its Scopes is enabled, so the --stats of one interpreter never
+	// switches counting on or off for the others; otherwise it costs one thread local check per allocation
+	class AllocationCounter
+	{
+	public:
+		class Scope
+		{
+		public:
+			explicit Scope(bool enabled) : enabled_(enabled) { if (enabled_) depth_++; }
+			~Scope() { if (enabled_) depth_--; }
+
+			Scope(const Scope&) = delete;
+			Scope& operator=(const Scope&) = delete;
+
+		private:
+			bool enabled_;
+		};
+
+		static bool installed() { return installed_.load(std::memory_order_relaxed); } // operator new is replaced
+		static void setInstalled() { installed_.store(true, std::memory_order_relaxed); }
+
+		// of the calling thread
+		static unsigned long long allocations() { return allocations_; }
+		static unsigned long long bytes() { return bytes_; }
+
+		static void count(std::size_t size)
+		{
+			if (depth_ == 0)
+				return;
+			allocations_++;
+			bytes_ += size;
+		}
+
+	private:
+		static std::atomic<bool> installed_;
+
+		// inline and constant initialized, so operator new reaches them without a TLS wrapper call
+		static inline thread_local unsigned depth_ = 0;
+		static inline thread_local unsigned long long allocations_ = 0;
+		static inline thread_local unsigned long long bytes_ = 0;
+	};
+}
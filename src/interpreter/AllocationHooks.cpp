@@ -0,0 +1,70 @@
+#include "AllocationCounter.hpp"
+
+#include <cstdlib>
+#include <new>
+
+// the replaced global operator new and delete for AllocationCounter, linked only into the KMSL executable:
+// a library must not replace them for the program which embeds it
+
+namespace
+{
+	const bool installed = (kmsl::AllocationCounter::setInstalled(), true);
+}
+
+// the aligned forms are left to the standard library, nothing in KMSL uses over-aligned types
+
+void* operator new(std::size_t size)
+{
+	kmsl::AllocationCounter::count(size);
+
+	void* p = std::malloc(size == 0 ? 1 : size);
+	if (!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+void* operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+	kmsl::AllocationCounter::count(size);
+	return std::malloc(size == 0 ? 1 : size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t& tag) noexcept
+{
+	return operator new(size, tag);
+}
+
+void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept
+{
+	std::free(p);
+}
@@ -0,0 +1,274 @@
+#include "AtomicWriter.hpp"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#endif
+
+namespace kmsl
+{
+	namespace fs = std::filesystem;
+
+	AtomicWriter::AtomicWriter(std::chrono::milliseconds window) : window_(window)
+	{
+		committer_ = std::thread(&AtomicWriter::run, this);
+	}
+
+	AtomicWriter::~AtomicWriter()
+	{
+		commitAll();
+
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			running_ = false;
+		}
+		wake_.notify_one();
+		committer_.join();
+	}
+
+	bool AtomicWriter::write(const std::string& path, const std::string& text, long long pos)
+	{
+		Pending pending;
+		pending.path = path;
+		pending.pos = pos;
+		pending.written = std::chrono::steady_clock::now();
+
+		fs::path target(path);
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			if (pending_.size() + committing_files_ >= max_pending_ && !pending_.count(key(path))) // a burst of paths does not run out of fds
+			{
+				lock.unlock();
+				commitAll();
+				lock.lock();
+			}
+			pending.temp = (target.parent_path() / ("." + target.filename().string() + "." + std::to_string(++temp_counter_) + ".tmp")).string();
+		}
+
+#ifdef _WIN32
+		HANDLE file = CreateFileA(pending.temp.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+		pending.file = file;
+
+		DWORD written = 0;
+		if (!text.empty() && (!WriteFile(file, text.data(), static_cast<DWORD>(text.size()), &written, nullptr) || written != text.size()))
+		{
+			discard(pending);
+			return false;
+		}
+#else
+		struct stat st;
+		mode_t mode = ::stat(path.c_str(), &st) == 0 ? (st.st_mode & 07777) : 0644; // the new file keeps the old mode
+
+		pending.fd = ::open(pending.temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, mode);
+		if (pending.fd == -1)
+			return false;
+
+		const char* data = text.data();
+		size_t left = text.size();
+		while (left > 0)
+		{
+			ssize_t n = ::write(pending.fd, data, left);
+			if (n <= 0)
+			{
+				discard(pending);
+				return false;
+			}
+			data += n;
+			left -= static_cast<size_t>(n);
+		}
+#endif
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		writes_++;
+
+		auto [it, inserted] = pending_.try_emplace(key(path));
+		if (!inserted)
+		{
+			discard(it->second); // never synced, the new version replaces it
+			superseded_++;
+		}
+		it->second = std::move(pending);
+
+		wake_.notify_one();
+		return true;
+	}
+
+	void AtomicWriter::commit(const std::string& path)
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		if (pending_.count(key(path)) || committing_)
+		{
+			lock.unlock();
+			commitAll();
+		}
+	}
+
+	void AtomicWriter::commitAll()
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		if (pending_.empty() && !committing_)
+			return;
+
+		urgent_ = true;
+		wake_.notify_one();
+		committed_.wait(lock, [&] { return pending_.empty() && !committing_; });
+	}
+
+	std::vector<std::pair<long long, std::string>> AtomicWriter::takeErrors()
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		std::vector<std::pair<long long, std::string>> errors;
+		errors.swap(errors_);
+		return errors;
+	}
+
+	void AtomicWriter::printStats(std::ostream& os)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		unsigned long long durable = writes_ - superseded_ - pending_.size();
+
+		os << "atomic writes: " << writes_ << " writes (" << superseded_ << " replaced before the commit), "
+			<< groups_ << " group commits, " << file_syncs_ << " file and " << dir_syncs_ << " dir syncs";
+		if (failed_ > 0)
+			os << ", " << failed_ << " failed";
+		if (durable > 0)
+			os << ", latency avg " << latency_us_ / 1000.0 / durable << " ms, max " << max_latency_us_ / 1000.0 << " ms";
+		os << std::endl;
+	}
+
+	void AtomicWriter::run()
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+
+		while (true)
+		{
+			wake_.wait(lock, [&] { return !pending_.empty() || !running_; });
+			if (pending_.empty())
+				break;
+
+			// the window starts with the first write, the writes in it share the syncs
+			auto first = std::min_element(pending_.begin(), pending_.end(),
+				[](const auto& a, const auto& b) { return a.second.written < b.second.written; })->second.written;
+			wake_.wait_until(lock, first + window_, [&] { return urgent_ || !running_; });
+
+			std::vector<Pending> group;
+			group.reserve(pending_.size());
+			for (auto& entry : pending_)
+				group.push_back(std::move(entry.second));
+			pending_.clear();
+			urgent_ = false;
+			committing_ = true;
+			committing_files_ = group.size();
+
+			lock.unlock();
+			commitGroup(group);
+			lock.lock();
+
+			committing_ = false;
+			committing_files_ = 0;
+			groups_++;
+			committed_.notify_all();
+		}
+	}
+
+	void AtomicWriter::commitGroup(std::vector<Pending>& group)
+	{
+		std::set<std::string> dirs;
+		std::vector<std::pair<long long, std::string>> errors;
+		unsigned long long file_syncs = 0;
+		long long latency_us = 0, max_latency_us = 0;
+
+		for (Pending& pending : group)
+		{
+			std::string error;
+#ifdef _WIN32
+			if (!FlushFileBuffers(pending.file)) // the data is on disk before the name points to it
+				error = "cannot be synced";
+			CloseHandle(pending.file);
+			pending.file = nullptr;
+			file_syncs++;
+
+			if (error.empty() && !MoveFileExA(pending.temp.c_str(), pending.path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+				error = "cannot replace the old file";
+#else
+			if (::fdatasync(pending.fd) != 0) // the data is on disk before the name points to it
+				error = std::string("cannot be synced: ") + std::strerror(errno);
+			::close(pending.fd);
+			pending.fd = -1;
+			file_syncs++;
+
+			if (error.empty() && std::rename(pending.temp.c_str(), pending.path.c_str()) != 0)
+				error = std::string("cannot replace the old file: ") + std::strerror(errno);
+			if (error.empty())
+			{
+				std::string dir = fs::path(pending.path).parent_path().string();
+				dirs.insert(dir.empty() ? "." : dir);
+			}
+#endif
+			if (!error.empty())
+			{
+				std::error_code ec;
+				fs::remove(pending.temp, ec);
+				errors.emplace_back(pending.pos, "File '" + pending.path + "' was not written, it " + error);
+			}
+		}
+
+#ifndef _WIN32
+		// one sync per dir makes all renames in it durable
+		for (const std::string& dir : dirs)
+		{
+			int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+			if (fd != -1)
+			{
+				::fsync(fd);
+				::close(fd);
+			}
+		}
+#endif
+
+		auto now = std::chrono::steady_clock::now();
+		for (const Pending& pending : group)
+		{
+			long long us = std::chrono::duration_cast<std::chrono::microseconds>(now - pending.written).count();
+			latency_us += us;
+			max_latency_us = std::max(max_latency_us, us);
+		}
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		file_syncs_ += file_syncs;
+		dir_syncs_ += dirs.size();
+		failed_ += errors.size();
+		errors_.insert(errors_.end(), errors.begin(), errors.end());
+		latency_us_ += latency_us;
+		max_latency_us_ = std::max(max_latency_us_, max_latency_us);
+	}
+
+	void AtomicWriter::discard(Pending& pending)
+	{
+#ifdef _WIN32
+		if (pending.file)
+			CloseHandle(pending.file);
+		pending.file = nullptr;
+#else
+		if (pending.fd != -1)
+			::close(pending.fd);
+		pending.fd = -1;
+#endif
+		std::error_code ec;
+		fs::remove(pending.temp, ec);
+	}
+
+	std::string AtomicWriter::key(const std::string& path)
+	{
+		return fs::path(path).lexically_normal().string();
+	}
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <set>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <filesystem>
+#include <ostream>
+
+namespace kmsl
+{
+	// WRITEFILE with kmsl --atomic-write: the text goes into a temp file next to the target, which
+	// replaces the target with a rename, so after a crash the file has the old or the new text, never half of it
+	// the fsyncs are group commits: every `window` the pending files are synced, renamed and each of
+	// their dirs is synced once; a file written again before that only syncs the last version
+	// a write which fails in the commit is kept with its position for takeErrors, and at most
+	// max_pending_ temp files stay open: the next write commits them first
+	class AtomicWriter
+	{
+	public:
+		explicit AtomicWriter(std::chrono::milliseconds window = std::chrono::milliseconds(10));
+		~AtomicWriter(); // commits everything
+
+		bool write(const std::string& path, const std::string& text, long long pos = 0); // false if the temp file cannot be created
+
+		void commit(const std::string& path); // right now, before the file is read, appended etc.
+		void commitAll();
+		std::vector<std::pair<long long, std::string>> takeErrors(); // failed commits since the last call
+
+		void printStats(std::ostream& os);
+
+	private:
+		struct Pending
+		{
+			std::string path;
+			std::string temp;
+			long long pos = 0; // of the WRITEFILE, for the error
+#ifdef _WIN32
+			void* file = nullptr; // open temp file, a HANDLE
+#else
+			int fd = -1; // open temp file
+#endif
+			std::chrono::steady_clock::time_point written;
+		};
+
+		void run();
+		void commitGroup(std::vector<Pending>& group); // without the lock
+		static void discard(Pending& pending);
+		static std::string key(const std::string& path);
+
+		static constexpr size_t max_pending_ = 64; // open temp files
+
+		std::chrono::milliseconds window_;
+		std::thread committer_;
+
+		std::mutex mutex_;
+		std::condition_variable wake_; // something to commit or commit now
+		std::condition_variable committed_;
+		std::unordered_map<std::string, Pending> pending_; // the last version of every path
+		bool committing_ = false; // a group is on its way to disk
+		size_t committing_files_ = 0; // their temp files are still open too
+		bool urgent_ = false;
+		bool running_ = true;
+		unsigned long long temp_counter_ = 0;
+		std::vector<std::pair<long long, std::string>> errors_;
+
+		/* STATS */
+		unsigned long long writes_ = 0;
+		unsigned long long superseded_ = 0;
+		unsigned long long groups_ = 0;
+		unsigned long long file_syncs_ = 0;
+		unsigned long long dir_syncs_ = 0;
+		unsigned long long failed_ = 0;
+		long long latency_us_ = 0; // written -> durable
+		long long max_latency_us_ = 0;
+	};
+}
@@ -0,0 +1,86 @@
+#include "Convert.hpp"
+
+namespace kmsl
+{
+	namespace
+	{
+		std::string_view trimSign(std::string_view text)
+		{
+			size_t start = text.find_first_not_of(" \t\r\n");
+			if (start == std::string_view::npos)
+				return std::string_view();
+
+			text.remove_prefix(start);
+			if (text.size() > 1 && text[0] == '+' && text[1] != '-') // from_chars does not take '+'
+				text.remove_prefix(1);
+			return text;
+		}
+	}
+
+	std::string Convert::toString(int value)
+	{
+		std::string out;
+		append(out, value);
+		return out;
+	}
+
+	std::string Convert::toString(long long value)
+	{
+		std::string out;
+		append(out, value);
+		return out;
+	}
+
+	std::string Convert::toString(float value)
+	{
+		std::string out;
+		append(out, value);
+		return out;
+	}
+
+	void Convert::append(std::string& out, int value)
+	{
+		char buffer[16];
+		auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+		out.append(buffer, result.ptr);
+	}
+
+	void Convert::append(std::string& out, long long value)
+	{
+		char buffer[24];
+		auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+		out.append(buffer, result.ptr);
+	}
+
+	void Convert::append(std::string& out, float value)
+	{
+		char buffer[64];
+		auto result = std::to_chars(buffer, buffer + sizeof(buffer), value); // shortest round-trip
+		out.append(buffer, result.ptr);
+	}
+
+	bool Convert::parseInt(std::string_view text, int& value)
+	{
+		text = trimSign(text);
+		if (text.empty())
+			return false;
+
+		auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+		return result.ec == std::errc() && result.ptr == text.data() + text.size();
+	}
+
+	bool Convert::parseFloat(std::string_view text, float& value)
+	{
+		text = trimSign(text);
+		if (text.empty())
+			return false;
+
+		float parsed;
+		auto result = std::from_chars(text.data(), text.data() + text.size(), parsed);
+		if (result.ec != std::errc() || result.ptr != text.data() + text.size() || !std::isfinite(parsed))
+			return false;
+
+		value = parsed;
+		return true;
+	}
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <charconv>
+#include <cmath>
+
+namespace kmsl
+{
+	// number <-> string conversions of the interpreter, built on to_chars/from_chars:
+	// no locale, no stream, no allocation besides the result
+	// floats are written in the shortest form which reads back to the same value (0.1f -> "0.1")
+	class Convert
+	{
+	public:
+		static std::string toString(int value);
+		static std::string toString(long long value);
+		static std::string toString(float value);
+
+		static void append(std::string& out, int value);
+		static void append(std::string& out, long long value);
+		static void append(std::string& out, float value);
+
+		// the whole text has to be the number, like 'ss >> n && ss.eof()' it may start with spaces or '+'
+		static bool parseInt(std::string_view text, int& value);
+		static bool parseFloat(std::string_view text, float& value); // no inf/nan
+	};
+}
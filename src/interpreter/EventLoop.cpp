@@ -0,0 +1,117 @@
+#include "EventLoop.hpp"
+
+namespace kmsl
+{
+	void EventLoop::onKey(const AstNode* source, WORD keyCode, std::unique_ptr<AstNode> body)
+	{
+		InputState::start();
+
+		bool existed = false;
+		Handler& handler = add(source, std::move(body), existed);
+		if (existed && handler.key_code == keyCode)
+			return;
+
+		handler.key_code = keyCode;
+		handler.presses = InputState::pressCount(keyCode); // presses before ON KEY do not count
+		handler.interval = clock::duration::zero();
+	}
+
+	void EventLoop::every(const AstNode* source, clock::duration interval, std::unique_ptr<AstNode> body)
+	{
+		bool existed = false;
+		Handler& handler = add(source, std::move(body), existed);
+		if (existed && handler.key_code == 0 && handler.interval == interval)
+			return; // EVERY inside a loop keeps its rhythm
+
+		handler.timer++;
+		handler.key_code = 0;
+		handler.interval = interval;
+		handler.deadline = clock::now() + interval;
+
+		size_t index = &handler - handlers_.data();
+		wheel_.schedule((static_cast<uint64_t>(index) << 32) | handler.timer, handler.deadline);
+	}
+
+	EventLoop::Handler& EventLoop::add(const AstNode* source, std::unique_ptr<AstNode> body, bool& existed)
+	{
+		for (Handler& handler : handlers_)
+		{
+			if (handler.source == source)
+			{
+				existed = true;
+				handler.body = std::move(body);
+				return handler;
+			}
+		}
+
+		handlers_.push_back({ source, std::move(body), 0, 0, clock::duration::zero(), clock::time_point(), 0 });
+		return handlers_.back();
+	}
+
+	std::vector<std::shared_ptr<AstNode>> EventLoop::wait(clock::time_point until)
+	{
+		std::vector<std::shared_ptr<AstNode>> due; // shared, a handler may replace another one before it runs
+
+		while (true)
+		{
+			uint64_t version = InputState::version(); // read before checking, so no press gets lost
+			bool keys = false;
+
+			for (Handler& handler : handlers_)
+			{
+				if (handler.key_code == 0)
+					continue;
+
+				keys = true;
+				uint32_t presses = InputState::pressCount(handler.key_code);
+				if (presses != handler.presses)
+				{
+					handler.presses = presses; // several presses since the last run are handled once
+					due.push_back(handler.body);
+				}
+			}
+
+			clock::time_point now = clock::now();
+			for (uint64_t id : wheel_.advance(now))
+			{
+				Handler& handler = handlers_[static_cast<size_t>(id >> 32)];
+				if (static_cast<uint32_t>(id) != handler.timer)
+					continue;
+
+				max_lateness_ = std::max(max_lateness_, now - handler.deadline);
+				due.push_back(handler.body);
+
+				// no drift, but a handler which was busy for longer than its interval skips the missed runs
+				handler.deadline += handler.interval;
+				if (handler.deadline <= now)
+					handler.deadline = now + handler.interval;
+				wheel_.schedule(id, handler.deadline);
+			}
+
+			if (!due.empty() || now >= until)
+				break;
+
+			// only suspends the script with --multi; with timers alone the input is of no interest,
+			// waiting on it would start the input hooks and wake up at every mouse move
+			if (keys)
+				Scheduler::waitChange(version, std::min(until, wheel_.nextExpiry()));
+			else
+				Scheduler::sleepUntil(std::min(until, wheel_.nextExpiry()));
+		}
+
+		runs_ += due.size();
+		return due;
+	}
+
+	void EventLoop::printStats(std::ostream& os) const
+	{
+		size_t keys = 0;
+		for (const Handler& handler : handlers_)
+			if (handler.key_code != 0)
+				keys++;
+
+		os << "event loop: " << keys << " key handlers, " << handlers_.size() - keys << " timers, "
+			<< runs_ << " runs, max timer lateness "
+			<< std::chrono::duration<double, std::milli>(max_lateness_).count() << " ms" << std::endl;
+	}
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <ostream>
+
+#include "../AST/ast.hpp"
+#include "../io/InputState.hpp"
+#include "TimerWheel.hpp"
+#include "Scheduler.hpp"
+
+namespace kmsl
+{
+	// handlers of ON KEY and EVERY
+	// wait() sleeps on the input state until a key is pressed or the next timer expires,
+	// so an idle script costs no cpu; without ON KEY it only sleeps until the next timer
+	class EventLoop
+	{
+	public:
+		using clock = std::chrono::steady_clock;
+
+		bool empty() const { return handlers_.empty(); }
+
+		// running the same statement again replaces its handler
+		void onKey(const AstNode* source, WORD keyCode, std::unique_ptr<AstNode> body);
+		void every(const AstNode* source, clock::duration interval, std::unique_ptr<AstNode> body);
+
+		// returns the bodies of the due handlers, empty when `until` has passed
+		std::vector<std::shared_ptr<AstNode>> wait(clock::time_point until);
+
+		void printStats(std::ostream& os) const;
+
+	private:
+		struct Handler
+		{
+			const AstNode* source; // the ON/EVERY statement
+			std::shared_ptr<AstNode> body; // own copy, the console replaces its tree with every line
+			WORD key_code; // ON KEY
+			uint32_t presses; // press count already handled
+			clock::duration interval; // EVERY
+			clock::time_point deadline;
+			uint32_t timer; // generation, replaced handlers leave stale timers in the wheel
+		};
+
+		Handler& add(const AstNode* source, std::unique_ptr<AstNode> body, bool& existed);
+
+		std::vector<Handler> handlers_;
+		TimerWheel wheel_;
+
+		/* STATS */
+		unsigned long long runs_ = 0;
+		clock::duration max_lateness_ = clock::duration::zero(); // how late a timer fired
+	};
+}
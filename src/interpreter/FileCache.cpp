@@ -0,0 +1,178 @@
+#include "FileCache.hpp"
+
+namespace kmsl
+{
+	namespace
+	{
+		const size_t file_buffer_size = 1 << 16;
+	}
+
+	FileCache::FileCache(size_t max_open) : max_open_(max_open) {}
+
+	FileCache::~FileCache()
+	{
+		flushAll();
+	}
+
+	bool FileCache::write(const std::string& path, const std::string& text, long long pos)
+	{
+		// WRITEFILE replaces the content, an open handle is reopened with truncation
+		auto it = index_.find(key(path));
+		if (it != index_.end())
+			evict(it->second);
+
+		if (atomic_) // a pending atomic write of the path is replaced, not committed
+			return atomic_->write(path, text, pos);
+
+		Entry* entry = open(path, std::ios_base::out | std::ios_base::trunc);
+		if (!entry)
+			return false;
+
+		entry->pos = pos;
+		entry->file << text;
+		check(*entry);
+		return true;
+	}
+
+	bool FileCache::append(const std::string& path, const std::string& text, long long pos)
+	{
+		if (atomic_)
+			atomic_->commit(path); // appends to the committed file
+
+		Entry* entry = open(path, std::ios_base::app);
+		if (!entry)
+			return false;
+
+		entry->pos = pos;
+		entry->file << text;
+		check(*entry);
+		return true;
+	}
+
+	void FileCache::flush(const std::string& path)
+	{
+		auto it = index_.find(key(path));
+		if (it != index_.end())
+		{
+			it->second->file.flush();
+			check(*it->second);
+		}
+
+		if (atomic_)
+			atomic_->commit(path);
+	}
+
+	void FileCache::close(const std::string& path)
+	{
+		auto it = index_.find(key(path));
+		if (it != index_.end())
+			evict(it->second);
+
+		if (atomic_)
+			atomic_->commit(path);
+	}
+
+	void FileCache::flushAll()
+	{
+		for (Entry& entry : entries_)
+		{
+			entry.file.flush();
+			check(entry);
+		}
+
+		if (atomic_)
+			atomic_->commitAll();
+	}
+
+	void FileCache::setAtomic(bool enabled)
+	{
+		if (enabled && !atomic_)
+			atomic_ = std::make_unique<AtomicWriter>();
+		else if (!enabled)
+			atomic_.reset(); // commits the pending files
+	}
+
+	std::vector<std::pair<long long, std::string>> FileCache::takeErrors()
+	{
+		std::vector<std::pair<long long, std::string>> errors = std::move(errors_);
+		errors_.clear();
+
+		if (atomic_)
+		{
+			auto atomic = atomic_->takeErrors();
+			errors.insert(errors.end(), atomic.begin(), atomic.end());
+		}
+		return errors;
+	}
+
+	void FileCache::printStats(std::ostream& os) const
+	{
+		os << "file cache: " << opens_ << " opens, " << hits_ << " writes to open files, "
+			<< evictions_ << " closed by the limit of " << max_open_ << std::endl;
+
+		if (atomic_)
+			atomic_->printStats(os);
+	}
+
+	FileCache::Entry* FileCache::open(const std::string& path, std::ios_base::openmode mode)
+	{
+		std::string k = key(path);
+
+		auto it = index_.find(k);
+		if (it != index_.end())
+		{
+			entries_.splice(entries_.begin(), entries_, it->second);
+			hits_++;
+			return &entries_.front();
+		}
+
+		if (entries_.size() >= max_open_)
+		{
+			evict(std::prev(entries_.end()));
+			evictions_++;
+		}
+
+		entries_.emplace_front();
+		Entry& entry = entries_.front();
+		entry.path = k;
+		entry.buffer.resize(file_buffer_size);
+		entry.file.rdbuf()->pubsetbuf(entry.buffer.data(), entry.buffer.size()); // before open, otherwise it is ignored
+		entry.file.open(path, mode);
+
+		if (!entry.file.is_open())
+		{
+			entries_.pop_front();
+			return nullptr;
+		}
+
+		index_[k] = entries_.begin();
+		opens_++;
+		return &entry;
+	}
+
+	void FileCache::evict(std::list<Entry>::iterator it)
+	{
+		it->file.close(); // flushes
+		check(*it);
+		index_.erase(it->path);
+		entries_.erase(it);
+	}
+
+	void FileCache::check(Entry& entry)
+	{
+		if (entry.file.good())
+			return;
+
+		entry.file.clear(); // the next write tries again
+		if (entry.failed)
+			return;
+
+		entry.failed = true;
+		errors_.push_back({ entry.pos, "File '" + entry.path + "' was not fully written" });
+	}
+
+	std::string FileCache::key(const std::string& path)
+	{
+		return std::filesystem::path(path).lexically_normal().string();
+	}
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <fstream>
+#include <filesystem>
+#include <ostream>
+#include <memory>
+
+#include "AtomicWriter.hpp"
+
+namespace kmsl
+{
+	// open, buffered files of WRITEFILE and APPENDFILE, so logging in a loop does not open and close the file every time
+	// the buffers go out at the end of the script, before READFILE/COPY of the same file, with FLUSH and when the
+	// least recently used file is closed because too many are open; the same goes for pending atomic writes
+	class FileCache
+	{
+	public:
+		explicit FileCache(size_t max_open = 16);
+		~FileCache();
+
+		bool write(const std::string& path, const std::string& text, long long pos = 0); // WRITEFILE
+		bool append(const std::string& path, const std::string& text, long long pos = 0); // APPENDFILE
+
+		void flush(const std::string& path); // before the file is read
+		void close(const std::string& path); // before the file is removed, renamed or recreated
+		void flushAll(); // FLUSH, OS, end of the script
+
+		void setAtomic(bool enabled); // WRITEFILE through a temp file and a rename (kmsl --atomic-write)
+		AtomicWriter* atomic() const { return atomic_.get(); } // thread safe, ASYNC WRITEFILE uses it from its job
+		// writes which failed after WRITEFILE/APPENDFILE returned (a flush or close of the buffer),
+		// with the positions of their statements
+		std::vector<std::pair<long long, std::string>> takeErrors();
+
+		void printStats(std::ostream& os) const;
+
+	private:
+		struct Entry
+		{
+			std::string path;
+			std::vector<char> buffer;
+			std::ofstream file;
+			long long pos = 0; // of the last WRITEFILE/APPENDFILE, for its error
+			bool failed = false; // reported once, the stuck buffer fails again at every flush
+		};
+
+		Entry* open(const std::string& path, std::ios_base::openmode mode);
+		void evict(std::list<Entry>::iterator it);
+		void check(Entry& entry); // a failed write or flush of the stream becomes an error
+		static std::string key(const std::string& path); // './a.txt' and 'a.txt' are the same file
+
+		size_t max_open_;
+		std::unique_ptr<AtomicWriter> atomic_;
+		std::list<Entry> entries_; // the most recently used first
+		std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+		std::vector<std::pair<long long, std::string>> errors_;
+
+		/* STATS */
+		unsigned long long hits_ = 0;
+		unsigned long long opens_ = 0;
+		unsigned long long evictions_ = 0;
+	};
+}
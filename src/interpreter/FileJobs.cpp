@@ -0,0 +1,294 @@
+#include "FileJobs.hpp"
+
+namespace kmsl
+{
+	FileJobs::FileJobs(size_t threads) : thread_count_(threads)
+	{
+		if (thread_count_ == 0)
+			thread_count_ = std::clamp<size_t>(std::thread::hardware_concurrency(), 1, 4);
+	}
+
+	FileJobs::~FileJobs()
+	{
+		waitAll();
+
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			running_ = false;
+		}
+		wake_.notify_all();
+
+		for (std::thread& worker : workers_)
+			worker.join();
+
+		for (auto& own : own_threads_)
+			own.second.join();
+	}
+
+	int FileJobs::submit(const std::vector<std::string>& paths, size_t pos, Job job)
+	{
+		auto task = std::make_shared<Task>();
+		task->pos = pos;
+		task->job = std::move(job);
+		for (const std::string& path : paths)
+			task->paths.push_back(key(path));
+
+		int handle;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+
+			pending_.erase(std::remove_if(pending_.begin(), pending_.end(),
+				[](const std::shared_ptr<Task>& t) { return t->done; }), pending_.end());
+
+			for (const auto& earlier : pending_)
+			{
+				bool conflict = false;
+				for (const std::string& a : earlier->paths)
+					for (const std::string& b : task->paths)
+						conflict = conflict || overlaps(a, b);
+
+				if (conflict)
+					task->after.push_back(earlier);
+			}
+
+			handle = next_handle_++;
+			pending_.push_back(task);
+			tasks_.emplace(handle, task);
+			queue_.push_back(task);
+			max_queued_ = std::max(max_queued_, queue_.size());
+
+			if (workers_.empty())
+				for (size_t i = 0; i < thread_count_; i++)
+					workers_.emplace_back(&FileJobs::run, this);
+		}
+		wake_.notify_one();
+
+		return handle;
+	}
+
+	int FileJobs::submitOwnThread(size_t pos, Job job)
+	{
+		joinFinished();
+
+		auto task = std::make_shared<Task>();
+		task->pos = pos;
+		task->job = std::move(job);
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		int handle = next_handle_++;
+		pending_.push_back(task);
+		tasks_.emplace(handle, task);
+		own_thread_jobs_++;
+
+		own_threads_.emplace_back(task, std::thread([this, task]
+		{
+			Trace::setThreadName("exec");
+			std::unique_lock<std::mutex> lock(mutex_);
+			execute(task, lock);
+		}));
+
+		return handle;
+	}
+
+	bool FileJobs::valid(int handle) const
+	{
+		return handle >= 1 && handle < next_handle_; // only the script thread starts jobs
+	}
+
+	bool FileJobs::done(int handle)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		auto it = tasks_.find(handle);
+		return it == tasks_.end() || it->second->done;
+	}
+
+	std::string FileJobs::await(int handle)
+	{
+		std::string error;
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			auto it = tasks_.find(handle);
+			if (it == tasks_.end())
+				return "";
+
+			std::shared_ptr<Task> task = it->second;
+			finished_.wait(lock, [&] { return task->done; });
+
+			error = task->error;
+			tasks_.erase(handle);
+		}
+
+		joinFinished();
+		return error;
+	}
+
+	void FileJobs::waitFor(const std::string& path)
+	{
+		std::string k = key(path);
+
+		std::unique_lock<std::mutex> lock(mutex_);
+		finished_.wait(lock, [&] { return pathDone(k); });
+	}
+
+	void FileJobs::waitAll()
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			finished_.wait(lock, [&] { return allDone(); });
+		}
+
+		joinFinished();
+	}
+
+	bool FileJobs::idle(const std::string& path)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return pathDone(key(path));
+	}
+
+	bool FileJobs::idle()
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return allDone();
+	}
+
+	bool FileJobs::pathDone(const std::string& k) const
+	{
+		for (const auto& task : pending_)
+			if (!task->done)
+				for (const std::string& p : task->paths)
+					if (overlaps(p, k))
+						return false;
+		return true;
+	}
+
+	bool FileJobs::allDone() const
+	{
+		return std::all_of(pending_.begin(), pending_.end(), [](const std::shared_ptr<Task>& t) { return t->done; });
+	}
+
+	std::vector<std::pair<size_t, std::string>> FileJobs::takeErrors()
+	{
+		std::vector<std::pair<int, std::shared_ptr<Task>>> failed;
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		for (auto it = tasks_.begin(); it != tasks_.end();)
+		{
+			if (!it->second->done)
+			{
+				++it;
+				continue;
+			}
+
+			if (!it->second->error.empty())
+				failed.emplace_back(it->first, it->second);
+			it = tasks_.erase(it);
+		}
+
+		// in the order the jobs were started, not of the map
+		std::sort(failed.begin(), failed.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+		std::vector<std::pair<size_t, std::string>> errors;
+		for (const auto& f : failed)
+			errors.emplace_back(f.second->pos, f.second->error);
+		return errors;
+	}
+
+	void FileJobs::printStats(std::ostream& os)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		os << "file jobs: " << next_handle_ - 1 << " jobs (" << failed_ << " failed) on "
+			<< workers_.size() << " threads, max " << max_queued_ << " queued";
+		if (own_thread_jobs_ > 0)
+			os << ", " << own_thread_jobs_ << " on their own thread";
+		os << std::endl;
+	}
+
+	void FileJobs::run()
+	{
+		Trace::setThreadName("file jobs");
+		std::unique_lock<std::mutex> lock(mutex_);
+
+		while (true)
+		{
+			wake_.wait(lock, [&] { return !queue_.empty() || !running_; });
+			if (queue_.empty())
+				break;
+
+			std::shared_ptr<Task> task = queue_.front();
+			queue_.pop_front();
+
+			// the queue is in order, so the earlier jobs already run on other workers or are done
+			finished_.wait(lock, [&]
+			{
+				return std::all_of(task->after.begin(), task->after.end(), [](const std::shared_ptr<Task>& t) { return t->done; });
+			});
+			task->after.clear();
+
+			execute(task, lock);
+		}
+	}
+
+	void FileJobs::execute(const std::shared_ptr<Task>& task, std::unique_lock<std::mutex>& lock)
+	{
+		lock.unlock();
+		std::string error;
+		try
+		{
+			Trace::Span span("job", task->paths.empty() ? "exec" : "file");
+			if (span.active())
+				span.args("\"path\": \"%s\"", Trace::escape(task->paths.empty() ? "" : task->paths.front()).c_str());
+
+			error = task->job();
+		}
+		catch (const std::exception& e)
+		{
+			error = e.what();
+		}
+		lock.lock();
+
+		task->error = error;
+		task->done = true;
+		task->job = nullptr;
+		if (!error.empty())
+			failed_++;
+
+		finished_.notify_all();
+	}
+
+	void FileJobs::joinFinished()
+	{
+		std::vector<std::thread> finished;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			auto it = std::partition(own_threads_.begin(), own_threads_.end(),
+				[](const std::pair<std::shared_ptr<Task>, std::thread>& own) { return !own.first->done; });
+
+			for (auto done = it; done != own_threads_.end(); ++done)
+				finished.push_back(std::move(done->second));
+			own_threads_.erase(it, own_threads_.end());
+		}
+
+		// a done job only has to leave execute(), so this does not wait for long
+		for (std::thread& thread : finished)
+			thread.join();
+	}
+
+	bool FileJobs::overlaps(const std::string& a, const std::string& b)
+	{
+		// 'dir' and 'dir/a.txt' overlap, 'dir' and 'dir2' do not
+		const std::string& shorter = a.size() <= b.size() ? a : b;
+		const std::string& longer = a.size() <= b.size() ? b : a;
+
+		return longer.compare(0, shorter.size(), shorter) == 0 &&
+			(longer.size() == shorter.size() || longer[shorter.size()] == '/' || shorter == ".");
+	}
+
+	std::string FileJobs::key(const std::string& path)
+	{
+		std::string k = std::filesystem::path(path).lexically_normal().generic_string();
+		if (k.size() > 1 && k.back() == '/')
+			k.pop_back();
+		return k;
+	}
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <filesystem>
+#include <algorithm>
+#include <ostream>
+
+#include "../io/Trace.hpp"
+
+namespace kmsl
+{
+	// ASYNC COPY, WRITEFILE, REMOVE etc. run on a small thread pool, AWAIT and DONE take the returned handle
+	// jobs on the same path (or on a path inside a dir of another job) run in the order they were started
+	// ASYNC EXEC mostly waits for its process, so every one gets its own thread instead of a pool thread,
+	// which is joined once its job is done (the next EXEC, AWAIT or SYNC)
+	class FileJobs
+	{
+	public:
+		using Job = std::function<std::string()>; // returns the error, empty on success
+
+		explicit FileJobs(size_t threads = 0); // 0: one per core, at most 4
+		~FileJobs();
+
+		int submit(const std::vector<std::string>& paths, size_t pos, Job job); // the handle, starting at 1
+		int submitOwnThread(size_t pos, Job job);
+
+		bool valid(int handle) const;
+		bool done(int handle);
+		std::string await(int handle); // the error of the job, a job awaited before has none
+
+		void waitFor(const std::string& path); // before a blocking operation on the path
+		void waitAll();
+		bool idle(const std::string& path); // no job on the path is queued or running, waitFor would return at once
+		bool idle();
+		std::vector<std::pair<size_t, std::string>> takeErrors(); // errors nobody AWAITed, with their positions
+
+		void printStats(std::ostream& os);
+
+	private:
+		struct Task
+		{
+			std::vector<std::string> paths;
+			size_t pos;
+			Job job;
+			std::vector<std::shared_ptr<Task>> after; // earlier jobs on the same paths
+			bool done = false;
+			std::string error;
+		};
+
+		void run();
+		void execute(const std::shared_ptr<Task>& task, std::unique_lock<std::mutex>& lock);
+		void joinFinished(); // own threads of done jobs, without the lock
+		bool pathDone(const std::string& k) const; // with the lock
+		bool allDone() const; // with the lock
+		static bool overlaps(const std::string& a, const std::string& b);
+		static std::string key(const std::string& path);
+
+		size_t thread_count_;
+		std::vector<std::thread> workers_; // started by the first job
+		std::vector<std::pair<std::shared_ptr<Task>, std::thread>> own_threads_; // still running or not joined yet
+		bool running_ = true;
+
+		std::mutex mutex_;
+		std::condition_variable wake_; // a job was queued
+		std::condition_variable finished_; // a job is done
+
+		std::deque<std::shared_ptr<Task>> queue_;
+		// by handle until it is awaited or its error is reported, a handle not in it any more is done
+		std::unordered_map<int, std::shared_ptr<Task>> tasks_;
+		int next_handle_ = 1;
+		std::vector<std::shared_ptr<Task>> pending_; // not done yet, for the path dependencies
+
+		/* STATS */
+		unsigned long long failed_ = 0;
+		size_t max_queued_ = 0;
+		unsigned long long own_thread_jobs_ = 0;
+	};
+}
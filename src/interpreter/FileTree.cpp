@@ -0,0 +1,301 @@
+#include "FileTree.hpp"
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <linux/fs.h>
+#include <cerrno>
+#endif
+
+namespace kmsl
+{
+	namespace fs = std::filesystem;
+
+	FileTree::FileTree(size_t threads) : thread_count_(threads), calls_(0), files_(0), dirs_(0), bytes_(0), kernel_copies_(0), time_us_(0)
+	{
+		if (thread_count_ == 0)
+			thread_count_ = std::clamp<size_t>(std::thread::hardware_concurrency(), 1, 8);
+	}
+
+	std::string FileTree::copy(const std::string& from, const std::string& to)
+	{
+		calls_++;
+		auto start = std::chrono::steady_clock::now();
+		std::error_code ec;
+		std::string error;
+
+		if (!fs::exists(from, ec))
+			error = "'" + from + "' cannot be found";
+		else if (!fs::is_directory(from, ec))
+			error = copyFile(from, to);
+		else if (!fs::create_directories(to, ec) && ec)
+			error = "Dir '" + to + "' cannot be created: " + ec.message();
+		else
+		{
+			fs::path root(from), target(to);
+			error = walk(root, [&](const fs::directory_entry& entry, bool is_dir) -> std::string
+			{
+				std::error_code ec;
+				fs::path destination = target / entry.path().lexically_relative(root);
+
+				if (is_dir)
+				{
+					fs::create_directory(destination, ec);
+					dirs_++;
+					return ec ? "Dir '" + destination.string() + "' cannot be created: " + ec.message() : "";
+				}
+
+				if (entry.is_symlink(ec))
+				{
+					fs::remove(destination, ec);
+					fs::copy_symlink(entry.path(), destination, ec);
+					return ec ? "'" + entry.path().string() + "' cannot be copied: " + ec.message() : "";
+				}
+
+				return copyFile(entry.path(), destination);
+			});
+		}
+
+		time_us_ += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+		return error;
+	}
+
+	std::string FileTree::remove(const std::string& path)
+	{
+		calls_++;
+		auto start = std::chrono::steady_clock::now();
+		std::error_code ec;
+		std::string error;
+
+		if (!fs::exists(fs::symlink_status(path, ec)))
+			error = "'" + path + "' does not exists";
+		else if (!fs::is_directory(fs::symlink_status(path, ec)))
+		{
+			if (fs::remove(path, ec))
+				files_++;
+			else
+				error = "'" + path + "' cannot be removed: " + ec.message();
+		}
+		else
+		{
+			// files go in parallel, the dirs after them, deepest first
+			std::mutex mutex;
+			std::vector<fs::path> dirs;
+
+			error = walk(path, [&](const fs::directory_entry& entry, bool is_dir) -> std::string
+			{
+				if (is_dir)
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					dirs.push_back(entry.path());
+					return "";
+				}
+
+				std::error_code ec;
+				std::uintmax_t size = entry.is_regular_file(ec) && !entry.is_symlink(ec) ? entry.file_size(ec) : 0;
+				if (!fs::remove(entry.path(), ec) && ec)
+					return "'" + entry.path().string() + "' cannot be removed: " + ec.message();
+
+				files_++;
+				bytes_ += size;
+				return "";
+			});
+
+			std::sort(dirs.begin(), dirs.end(), [](const fs::path& a, const fs::path& b) { return a.native().size() > b.native().size(); });
+			dirs.push_back(path);
+
+			for (const fs::path& dir : dirs)
+			{
+				if (!error.empty())
+					break;
+
+				if (!fs::remove(dir, ec) && ec)
+					error = "Dir '" + dir.string() + "' cannot be removed: " + ec.message();
+				else
+					dirs_++;
+			}
+		}
+
+		time_us_ += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+		return error;
+	}
+
+	void FileTree::printStats(std::ostream& os) const
+	{
+		double seconds = time_us_.load() / 1e6;
+		unsigned long long files = files_.load();
+		unsigned long long bytes = bytes_.load();
+
+		os << "file trees: " << files << " files, " << dirs_.load() << " dirs, " << bytes << " bytes in " << seconds << " s";
+		if (seconds > 0)
+			os << " (" << static_cast<unsigned long long>(files / seconds) << " files/s, " << bytes / seconds / (1 << 20) << " MB/s)";
+		os << ", " << kernel_copies_.load() << " in-kernel copies on " << thread_count_ << " threads" << std::endl;
+	}
+
+	std::string FileTree::walk(const fs::path& root, const Visit& visit)
+	{
+		struct Item
+		{
+			fs::directory_entry entry;
+			bool is_dir;
+		};
+
+		std::mutex mutex;
+		std::condition_variable changed;
+		std::deque<Item> queue;
+		size_t busy = 0; // threads working on an item, they may queue more
+		std::string error;
+
+		queue.push_back({ fs::directory_entry(root), true });
+
+		auto worker = [&]
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+
+			while (true)
+			{
+				changed.wait(lock, [&] { return !queue.empty() || busy == 0 || !error.empty(); });
+				if (!error.empty() || queue.empty())
+					break;
+
+				Item item = std::move(queue.front());
+				queue.pop_front();
+				busy++;
+				lock.unlock();
+
+				std::string item_error;
+				std::vector<Item> children;
+
+				if (item.entry.path() != root)
+					item_error = visit(item.entry, item.is_dir);
+
+				if (item.is_dir && item_error.empty())
+				{
+					std::error_code ec;
+					for (fs::directory_iterator it(item.entry.path(), ec), end; !ec && it != end; it.increment(ec))
+					{
+						std::error_code type_ec;
+						bool is_dir = it->is_directory(type_ec) && !it->is_symlink(type_ec); // links are copied/removed, not followed
+						children.push_back({ *it, is_dir });
+					}
+
+					if (ec)
+						item_error = "Dir '" + item.entry.path().string() + "' cannot be read: " + ec.message();
+				}
+
+				lock.lock();
+				busy--;
+
+				if (!item_error.empty() && error.empty())
+					error = item_error;
+
+				for (Item& child : children)
+					queue.push_back(std::move(child));
+
+				changed.notify_all();
+			}
+		};
+
+		std::vector<std::thread> threads;
+		for (size_t i = 1; i < thread_count_; i++)
+			threads.emplace_back(worker);
+
+		worker();
+
+		for (std::thread& thread : threads)
+			thread.join();
+
+		return error;
+	}
+
+	std::string FileTree::copyFile(const fs::path& from, const fs::path& to)
+	{
+#ifdef __linux__
+		int in = ::open(from.c_str(), O_RDONLY | O_CLOEXEC);
+		if (in == -1)
+			return "'" + from.string() + "' cannot be open";
+
+		struct stat st;
+		if (::fstat(in, &st) == -1 || !S_ISREG(st.st_mode))
+		{
+			::close(in); // not a regular file, std::filesystem knows what to do with it
+		}
+		else
+		{
+			int out = ::open(to.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, st.st_mode & 07777);
+			if (out == -1)
+			{
+				::close(in);
+				return "'" + to.string() + "' cannot be created";
+			}
+
+			bool copied = ::ioctl(out, FICLONE, in) == 0; // shares the blocks on btrfs, xfs etc.
+			if (!copied)
+			{
+				off_t left = st.st_size;
+				while (left > 0)
+				{
+					ssize_t n = ::copy_file_range(in, nullptr, out, nullptr, static_cast<size_t>(left), 0);
+					if (n <= 0)
+						break;
+					left -= n;
+				}
+				copied = left == 0;
+			}
+
+			::close(in);
+			::close(out);
+
+			if (copied)
+			{
+				files_++;
+				bytes_ += st.st_size;
+				kernel_copies_++;
+				return "";
+			}
+			// e.g. EXDEV on old kernels, the portable copy below overwrites the partial file
+		}
+#endif
+		std::error_code ec;
+		fs::copy_file(from, to, fs::copy_options::overwrite_existing, ec);
+		if (ec)
+			return "'" + from.string() + "' cannot be copied: " + ec.message();
+
+		files_++;
+		bytes_ += fs::file_size(to, ec);
+		return "";
+	}
+
+	bool DirReader::open(const std::string& path)
+	{
+		std::error_code ec;
+		it_ = fs::directory_iterator(path, ec);
+		return !ec;
+	}
+
+	bool DirReader::readLine(std::string& line)
+	{
+		line.clear();
+
+		if (eof())
+			return false;
+
+		std::error_code ec;
+		line = it_->path().filename().string();
+		if (it_->is_directory(ec))
+			line += '/';
+
+		it_.increment(ec);
+		if (ec)
+			it_ = fs::directory_iterator(); // unreadable rest, ends the listing
+
+		return true;
+	}
+
+	bool DirReader::eof()
+	{
+		return it_ == fs::directory_iterator();
+	}
+}
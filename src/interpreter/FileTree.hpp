@@ -0,0 +1,64 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <functional>
+#include <filesystem>
+#include <system_error>
+#include <algorithm>
+#include <chrono>
+#include <ostream>
+
+#include "LineReader.hpp"
+
+namespace kmsl
+{
+	// COPYTREE and REMOVETREE: the tree is walked by a queue shared by one thread per core,
+	// every dir and file is one item, so a flat dir with many files is spread over the threads too
+	// on linux files are copied with a reflink (FICLONE) or copy_file_range, so the data stays in the kernel
+	class FileTree
+	{
+	public:
+		explicit FileTree(size_t threads = 0); // 0: one per core, at most 8
+
+		std::string copy(const std::string& from, const std::string& to); // the error, empty on success
+		std::string remove(const std::string& path);
+
+		bool used() const { return calls_.load() > 0; }
+		void printStats(std::ostream& os) const;
+
+	private:
+		using Visit = std::function<std::string(const std::filesystem::directory_entry&, bool is_dir)>;
+
+		std::string walk(const std::filesystem::path& root, const Visit& visit); // visit runs on many threads
+		std::string copyFile(const std::filesystem::path& from, const std::filesystem::path& to);
+
+		size_t thread_count_;
+
+		/* STATS */
+		std::atomic<unsigned long long> calls_;
+		std::atomic<unsigned long long> files_;
+		std::atomic<unsigned long long> dirs_;
+		std::atomic<unsigned long long> bytes_;
+		std::atomic<unsigned long long> kernel_copies_; // reflink or copy_file_range
+		std::atomic<long long> time_us_;
+	};
+
+	// LISTDIR: the names in a dir one by one, dirs end with '/'
+	class DirReader : public LineSource
+	{
+	public:
+		bool open(const std::string& path);
+
+		bool readLine(std::string& line) override;
+		bool eof() override;
+
+	private:
+		std::filesystem::directory_iterator it_;
+	};
+}
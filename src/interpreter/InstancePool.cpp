@@ -0,0 +1,87 @@
+#include "InstancePool.hpp"
+
+namespace kmsl
+{
+	InstancePool::InstancePool(size_t threads)
+	{
+		if (threads == 0)
+			threads = std::max(1u, std::thread::hardware_concurrency());
+
+		for (size_t i = 0; i < threads; i++)
+			workers_.emplace_back(&InstancePool::run, this);
+	}
+
+	InstancePool::~InstancePool()
+	{
+		wait();
+
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			running_ = false;
+		}
+		wake_.notify_all();
+
+		for (std::thread& worker : workers_)
+			worker.join();
+	}
+
+	void InstancePool::submit(std::shared_ptr<const Program> program, size_t instances, Configure configure)
+	{
+		if (!program || instances == 0)
+			return;
+
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			queue_.push_back({ std::move(program), std::move(configure), instances });
+			active_ += instances;
+		}
+		wake_.notify_all();
+	}
+
+	size_t InstancePool::wait()
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		finished_.wait(lock, [this] { return active_ == 0; });
+
+		size_t failed = failed_;
+		failed_ = 0;
+		return failed;
+	}
+
+	void InstancePool::run()
+	{
+		Trace::setThreadName("instance pool");
+
+		std::unique_lock<std::mutex> lock(mutex_);
+		while (true)
+		{
+			wake_.wait(lock, [this] { return !queue_.empty() || !running_; });
+			if (queue_.empty())
+				return;
+
+			Batch& batch = queue_.front();
+			std::shared_ptr<const Program> program = batch.program;
+			Configure configure = batch.configure;
+			if (--batch.remaining == 0)
+				queue_.pop_front();
+
+			lock.unlock();
+
+			bool failed;
+			{
+				Interpreter interpreter;
+				if (configure)
+					configure(interpreter);
+				interpreter.setProgram(program);
+				interpreter.execute();
+				failed = interpreter.hasErrors();
+			}
+
+			lock.lock();
+			if (failed)
+				failed_++;
+			if (--active_ == 0)
+				finished_.notify_all();
+		}
+	}
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+
+#include "Interpreter.hpp"
+#include "Program.hpp"
+
+namespace kmsl
+{
+	// embedding: runs instances of compiled programs on a pool of threads
+	// every instance gets a fresh Interpreter, they share nothing but the Program
+	class InstancePool
+	{
+	public:
+		using Configure = std::function<void(Interpreter&)>; // before the run, for the limits, polling etc.
+
+		explicit InstancePool(size_t threads = 0); // 0: one per core
+		~InstancePool(); // waits for the queued instances
+
+		void submit(std::shared_ptr<const Program> program, size_t instances = 1, Configure configure = nullptr);
+		size_t wait(); // until every instance has ended, returns how many ended with errors since the last wait()
+
+	private:
+		struct Batch
+		{
+			std::shared_ptr<const Program> program;
+			Configure configure;
+			size_t remaining; // not started yet
+		};
+
+		void run();
+
+		std::vector<std::thread> workers_;
+		bool running_ = true;
+
+		std::mutex mutex_;
+		std::condition_variable wake_; // instances were queued
+		std::condition_variable finished_; // the last running instance ended
+
+		std::deque<Batch> queue_;
+		size_t active_ = 0; // queued or running
+		size_t failed_ = 0;
+	};
+}
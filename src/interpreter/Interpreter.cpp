@@ -4,7 +4,10 @@ namespace kmsl
 {
 	Interpreter::Interpreter() : break_loop_(false), continue_loop_(false),
 		exit_program_(false), logging_enabled_(false), console_running_(false), deepness_(0),
-		error_handler_(), has_errors_(false) {}
+		error_handler_(), exit_code_(0), has_errors_(false), async_input_(false), in_handler_(false), limited_(false), max_steps_(0), timeout_(0),
+		deadline_(std::chrono::steady_clock::time_point::max()), max_memory_(0), steps_(0), string_bytes_(0),
+		strict_poll_(false), poll_latency_(std::chrono::milliseconds(2)), stats_enabled_(false), stats_json_(false), streaming_(false),
+		random_(std::random_device{}()), stream_statements_(0), stream_lines_(0) {}
 
 	Interpreter::~Interpreter()
 	{
@@ -13,11 +16,74 @@ namespace kmsl
 
 	void Interpreter::execute()
 	{
+		PhaseStats::Scope phase(phases_, Phase::EXECUTION);
+
 		if (!has_errors_)
+		{
+			visit(root_.get());
+
+			// handlers keep the script alive until EXIT, in the console they only run during WAIT
+			if (!console_running_ && !events_.empty())
+			{
+				runEvents(deadline_);
+				limitReached(0, "while waiting for the ON KEY and EVERY handlers", 0);
+			}
+		}
+
+		finish();
+	}
+
+	void Interpreter::runStream(std::istream& in)
+	{
+		streaming_ = true;
+		StatementReader reader(in);
+		std::string statement;
+
+		while (!exit_program_ && reader.next(statement))
+		{
+			error_handler_.setFirstLine(static_cast<int>(reader.line()));
+			setCode(FileReader::replaceEscapedNewlines(statement));
+			if (has_errors_) // syntax and semantic errors stop the script, like in a file
+				break;
+
+			PhaseStats::Scope phase(phases_, Phase::EXECUTION);
 			visit(root_.get());
 
+			// runtime errors are shown right away, the next statement replaces the code of the error handler
+			if (error_handler_.getErrorsCount() > 0)
+			{
+				output_.flush();
+				error_handler_.showErrors();
+				error_handler_.clearErrors();
+			}
+		}
+
+		{
+			PhaseStats::Scope phase(phases_, Phase::EXECUTION);
+
+			if (!has_errors_ && !exit_program_ && !events_.empty())
+			{
+				runEvents(deadline_);
+				limitReached(0, "while waiting for the ON KEY and EVERY handlers", 0);
+			}
+
+			finish();
+		}
+		stream_statements_ = reader.statements();
+		stream_lines_ = reader.lines();
+	}
+
+	void Interpreter::finish()
+	{
+		syncInput(); // the script is done when its ASYNC input is done
+		syncFiles();
+		files_.flushAll();
+		reportFileErrors();
+		output_.flush();
+
 		if (error_handler_.getErrorsCount() > 0)
 		{
+			output_.flush(); // before the errors on stderr
 			error_handler_.showErrors();
 			has_errors_ = true;
 			error_handler_.clearErrors();
@@ -36,10 +102,11 @@ namespace kmsl
 		while (true)
 		{
 			if (in_construction)
-				std::cout << ". ";
+				output_.write(". ");
 			else
-				std::cout << "> ";
+				output_.write("> ");
 
+			output_.flush();
 			std::getline(std::cin, input);
 
 			if (input == "")
@@ -48,7 +115,7 @@ namespace kmsl
 			Lexer l(input);
 			std::vector<Token> tokens = l.scanTokens();
 
-			if (tokens[0].type == TokenType::IF || tokens[0].type == TokenType::WHILE || tokens[0].type == TokenType::FOR || in_construction)
+			if (tokens[0].type == TokenType::IF || tokens[0].type == TokenType::WHILE || tokens[0].type == TokenType::FOR || tokens[0].type == TokenType::ON || tokens[0].type == TokenType::EVERY || in_construction)
 			{
 				in_construction = true;
 				construction += input + '\n';
@@ -66,7 +133,7 @@ namespace kmsl
 				if (exit_program_)
 					break;
 
-				std::cout << std::endl;
+				output_.write('\n');
 				construction.clear();
 			}
 		}
@@ -79,21 +146,34 @@ namespace kmsl
 		std::string code = c + " "; // for the error_handler, when it cuts the code in lines
 		error_handler_.setCode(FileReader::replaceEscapedNewlines(code));
 
-		kmsl::Lexer lexer(code);
-		std::vector<kmsl::Token> tokens = lexer.scanTokens();
+		std::vector<kmsl::Token> tokens;
+		{
+			PhaseStats::Scope phase(phases_, Phase::LEXER);
+			kmsl::Lexer lexer(code);
+			tokens = lexer.scanTokens();
+		}
+		phases_.addTokens(tokens.size());
+
+		if (!auto_visit)
+			profiler_.setCode(code, error_handler_.getFirstLine());
 
 		if (logging_enabled_)
 		{
-			std::cout << "LEXER: " << std::endl;
+			output_.write("LEXER: \n");
 			for (const auto& t : tokens)
-				std::cout << "Pos: " << t.pos << " Type: " << (int)t.type << " Text: " << t.text << std::endl;
+				output_.write("Pos: " + Convert::toString(t.pos) + " Type: " + Convert::toString((int)t.type) + " Text: " + t.text + '\n');
 		}
 
-		kmsl::Parser parser(tokens, error_handler_);
-		std::unique_ptr<BlockNode> ast = parser.parse();
+		std::unique_ptr<BlockNode> ast;
+		{
+			PhaseStats::Scope phase(phases_, Phase::PARSER);
+			kmsl::Parser parser(tokens, error_handler_);
+			ast = parser.parse();
+		}
 
 		if (error_handler_.getErrorsCount() > 0)
 		{
+			output_.flush();
 			error_handler_.showErrors();
 			has_errors_ = true;
 			error_handler_.clearErrors();
@@ -102,17 +182,21 @@ namespace kmsl
 
 		if (logging_enabled_)
 		{
-			std::cout << "PARSER: " << std::endl;
-			std::cout << ast->toString() << std::endl << std::endl;
+			output_.write("PARSER: \n");
+			output_.write(ast->toString() + "\n\n");
 		}
 
-		kmsl::SemanticAnalyzer semantic(ast, error_handler_);
-		if (console_running_)
-			semantic.set_symbols(&symbols_);
-		semantic.analyze();
+		{
+			PhaseStats::Scope phase(phases_, Phase::SEMANTIC);
+			kmsl::SemanticAnalyzer semantic(ast, error_handler_);
+			if (console_running_ || streaming_) // the variables of the previous lines are known
+				semantic.set_symbols(&symbols_);
+			semantic.analyze();
+		}
 
 		if (error_handler_.getErrorsCount() > 0)
 		{
+			output_.flush();
 			error_handler_.showErrors();
 			has_errors_ = true;
 			error_handler_.clearErrors();
@@ -120,17 +204,18 @@ namespace kmsl
 		}
 
 		if (logging_enabled_)
-			std::cout << "SEMANTIC ANALYZER: OK" << std::endl << "PROGRAM OUTPUT:" << std::endl;
-
-		std::srand(std::time(0));
+			output_.write("SEMANTIC ANALYZER: OK\nPROGRAM OUTPUT:\n");
 
 		// DO code must not be setted in root_
 		if (auto_visit) 
 		{
+			profiler_.pushCode(code);
 			visit(ast.get());
+			profiler_.popCode();
 
 			if (error_handler_.getErrorsCount() > 0)
 			{
+				output_.flush();
 				error_handler_.showErrors();
 				has_errors_ = true;
 				error_handler_.clearErrors();
@@ -141,8 +226,33 @@ namespace kmsl
 			root_ = std::move(ast);
 	}
 
+	void Interpreter::setProgram(std::shared_ptr<const Program> program)
+	{
+		has_errors_ = false;
+		error_handler_.setCode(FileReader::replaceEscapedNewlines(program->code()));
+		profiler_.setCode(program->code(), error_handler_.getFirstLine());
+		root_ = std::shared_ptr<BlockNode>(program, program->root());
+	}
+
 	variant Interpreter::visitNode(AstNode* node)
 	{
+		Profiler::Scope scope(profiler_, node);
+
+		Trace::Span span;
+		if (Trace::enabled() && isBuiltinCall(node))
+		{
+			span.begin("builtin", Profiler::label(node).c_str());
+			span.args("\"line\": %d", profiler_.line(node));
+		}
+
+		if (Metrics::enabled())
+		{
+			if (isFileOperation(node))
+				Metrics::add(Metrics::Counter::FILE_OPERATIONS);
+			else if (dynamic_cast<ExecNode*>(node))
+				Metrics::add(Metrics::Counter::PROCESSES);
+		}
+
 		if (auto blockNode = dynamic_cast<BlockNode*>(node))
 			return visit(blockNode);
 		else if (auto variableNode = dynamic_cast<VariableNode*>(node))
@@ -189,6 +299,12 @@ namespace kmsl
 			return visit(mouseNode);
 		else if (auto commandNode = dynamic_cast<CommandNode*>(node))
 			visit(commandNode);
+		else if (auto asyncNode = dynamic_cast<AsyncNode*>(node))
+			return visit(asyncNode);
+		else if (auto triggerNode = dynamic_cast<TriggerNode*>(node))
+			visit(triggerNode);
+		else if (auto execNode = dynamic_cast<ExecNode*>(node))
+			return visit(execNode);
 
 		return variant();
 	}
@@ -196,6 +312,8 @@ namespace kmsl
 	variant Interpreter::visit(BlockNode* node)
 	{
 		deepness_++;
+		bool batching = false;
+
 		for (auto& stmt : node->getStatements())
 		{
 			if (continue_loop_ || break_loop_ || exit_program_)
@@ -204,6 +322,14 @@ namespace kmsl
 				break;
 			}
 
+			// zero-delay input of consecutive statements goes out together, anything else sends it first
+			bool input = isInputStatement(stmt.get());
+			if (input && !batching)
+				IoController::beginBatch();
+			else if (!input && batching)
+				IoController::endBatch();
+			batching = input;
+
 			auto binaryOpNode = dynamic_cast<BinarOpNode*>(stmt.get());
 			auto unarOpNode = dynamic_cast<UnarOpNode*>(stmt.get());
 
@@ -246,6 +372,10 @@ namespace kmsl
 				unarOpNode->op.type == TokenType::RFLOOR ||
 				unarOpNode->op.type == TokenType::READFILE ||
 				unarOpNode->op.type == TokenType::EXISTS ||
+				unarOpNode->op.type == TokenType::OPENREAD ||
+				unarOpNode->op.type == TokenType::READLINE ||
+				unarOpNode->op.type == TokenType::END_OF_FILE ||
+				unarOpNode->op.type == TokenType::DONE ||
 				unarOpNode->op.type == TokenType::PLUS || 
 				unarOpNode->op.type == TokenType::MINUS || 
 				unarOpNode->op.type == TokenType::BIT_NOT || 
@@ -255,9 +385,26 @@ namespace kmsl
 				is_printable_ = true;
 			}
 
+			Trace::Span span;
+			if (Trace::enabled())
+			{
+				span.begin("statement", Profiler::label(stmt.get()).c_str());
+				span.args("\"line\": %d", profiler_.line(stmt.get()));
+			}
+			Metrics::add(Metrics::Counter::STATEMENTS);
+			steps_++;
+
 			visitNode(stmt.get());
 		}
 
+		if (batching)
+			IoController::endBatch();
+
+		if (max_memory_)
+			for (const Variable& var : variables_)
+				if (var.deepness > deepness_)
+					string_bytes_ -= stringBytes(var.value);
+
 		variables_.erase(
 			std::remove_if(variables_.begin(), variables_.end(),
 				[&](const Variable& var) { return var.deepness > deepness_; }),
@@ -297,7 +444,12 @@ namespace kmsl
 		}
 		else if (node->token.type == TokenType::RANDOM)
 		{
-			temp_var_ = std::rand();
+			temp_var_ = std::uniform_int_distribution<int>(0, RAND_MAX)(random_); // the range of std::rand
+			return temp_var_;
+		}
+		else if (node->token.type == TokenType::EXITCODE)
+		{
+			temp_var_ = exit_code_;
 			return temp_var_;
 		}
 		else if (node->token.type == TokenType::MONTH || node->token.type == TokenType::WEEK ||
@@ -308,7 +460,11 @@ namespace kmsl
 			auto now = std::chrono::system_clock::now();
 			std::time_t now_time_t = std::chrono::system_clock::to_time_t(now);
 			std::tm local_time;
+#ifdef _WIN32
 			localtime_s(&local_time, &now_time_t);
+#else
+			localtime_r(&now_time_t, &local_time);
+#endif
 
 			switch (node->token.type)
 			{
@@ -406,13 +562,13 @@ namespace kmsl
 		{
 			variant value = visitNode(node->operand.get());
 			if (std::holds_alternative<int>(value))
-				std::cout << std::get<int>(value);
+				output_.write(std::get<int>(value));
 			else if (std::holds_alternative<float>(value))
-				std::cout << std::get<float>(value);
+				output_.write(std::get<float>(value));
 			else if (std::holds_alternative<std::string>(value))
-				std::cout << std::get<std::string>(value);
+				output_.write(std::get<std::string>(value));
 			else if (std::holds_alternative<bool>(value))
-				std::cout << (std::get<bool>(value) ? "TRUE" : "FALSE");
+				output_.write(std::get<bool>(value) ? "TRUE" : "FALSE");
 			else
 				error_handler_.report(ErrorType::RUNTIME_ERROR, "Unsupported type for printing", node->op.pos);
 		}
@@ -461,34 +617,20 @@ namespace kmsl
 			variant variable;
 
 			std::string input;
+			output_.flush(); // the question has to be visible
 			std::getline(std::cin, input);
 
-			std::stringstream ss(input);
-
 			int intValue;
 			float floatValue;
 
-			if (ss >> intValue && ss.eof()) 
+			if (Convert::parseInt(input, intValue))
 				variable = intValue;
-			else 
-			{
-				ss.clear(); 
-				ss.str(input); 
-
-
-				if (ss >> floatValue && ss.eof())
-					variable = floatValue;
-				else 
-					variable = input;
-			}
-
-			auto it = std::find_if(variables_.begin(), variables_.end(),
-				[&](const Variable& var) { return variableNode->token.text == var.name; });
+			else if (Convert::parseFloat(input, floatValue))
+				variable = floatValue;
+			else
+				variable = input;
 
-			if (it != variables_.end()) 
-				it->value = variable;
-			else 
-				variables_.emplace_back(variable, variableNode->token.text, deepness_);
+			setVariable(variableNode->token.text, variable);
 		}
 		else if (op == TokenType::STATE)
 		{
@@ -514,11 +656,38 @@ namespace kmsl
 				else if (std::holds_alternative<float>(operand))
 					time = std::get<float>(operand);
 
-				std::this_thread::sleep_for(std::chrono::milliseconds(static_cast<int>(time * 1000)));
+				output_.idle();
+
+				auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(static_cast<int>(time * 1000));
+				bool cut = until > deadline_; // --timeout ends during the WAIT
+				if (cut)
+					until = deadline_;
+
+				if (!events_.empty() && !in_handler_)
+					runEvents(until);
+				else
+					Scheduler::sleepUntil(until); // with --multi the other scripts run meanwhile
+
+				if (cut)
+					limitReached(node->op.pos, "in this WAIT", 0);
 			}
 			else
 				error_handler_.report(ErrorType::RUNTIME_ERROR, "WAIT parameter should be int/float", node->op.pos);
 		}
+		else if (op == TokenType::WAITKEY)
+		{
+			variant operand = visitNode(node->operand.get());
+
+			if (std::holds_alternative<std::string>(operand))
+			{
+				std::string key = std::get<std::string>(operand);
+				output_.idle();
+				if (!IoController::waitKey(key))
+					error_handler_.report(ErrorType::RUNTIME_ERROR, "Unknown key '" + key + "'", node->op.pos);
+			}
+			else
+				error_handler_.report(ErrorType::RUNTIME_ERROR, "WAITKEY parameter should be string", node->op.pos);
+		}
 		else if (op == TokenType::OS)
 		{
 			variant operand = visitNode(node->operand.get());
@@ -527,6 +696,8 @@ namespace kmsl
 			if (std::holds_alternative<std::string>(operand))
 			{
 				command = std::get<std::string>(operand);
+				output_.flush(); // the command writes to the same stdout
+				files_.flushAll(); // and may read our files
 				std::system(command.c_str());
 			}
 			else
@@ -598,6 +769,10 @@ namespace kmsl
 					return variant();
 				}
 
+				waitForJobs(filename);
+				files_.close(filename);
+				reportFileErrors(); // of a buffer of the file which did not go out
+				reads_.invalidate(filename);
 				std::ofstream file(filename);
 
 				if (!file.is_open())
@@ -616,6 +791,10 @@ namespace kmsl
 			if (std::holds_alternative<std::string>(operand))
 			{
 				filename = std::get<std::string>(operand);
+				waitForJobs(filename);
+				files_.close(filename);
+				reportFileErrors();
+				reads_.invalidate(filename);
 
 				if (std::filesystem::exists(filename))
 					std::filesystem::remove(filename);
@@ -633,13 +812,13 @@ namespace kmsl
 			if (std::holds_alternative<std::string>(operand))
 			{
 				filename = std::get<std::string>(operand);
-				if (std::filesystem::exists(filename))
-				{
-					kmsl::FileReader fr(filename);
-					std::string text = fr.read();
+				waitForJobs(filename);
+				files_.flush(filename);
+				reportFileErrors();
 
+				std::string text;
+				if (reads_.read(filename, text))
 					return text;
-				}
 				else 
 					error_handler_.report(ErrorType::RUNTIME_ERROR, "File '" + filename + "' cannot be open", node->op.pos);
 			}
@@ -654,11 +833,134 @@ namespace kmsl
 			if (std::holds_alternative<std::string>(operand))
 			{
 				filename = std::get<std::string>(operand);
-				return std::filesystem::exists(filename);
+				waitForJobs(filename);
+				files_.flush(filename); // a pending atomic write may create it
+				reportFileErrors();
+				return reads_.exists(filename);
 			}
 			else
 				error_handler_.report(ErrorType::RUNTIME_ERROR, "EXISTS parameter should be string", node->op.pos);
 		}
+		else if (op == TokenType::OPENREAD)
+		{
+			variant operand = visitNode(node->operand.get());
+			std::string filename;
+
+			if (std::holds_alternative<std::string>(operand))
+			{
+				filename = std::get<std::string>(operand);
+				waitForJobs(filename);
+				files_.flush(filename);
+				reportFileErrors();
+
+				auto reader = std::make_unique<LineReader>();
+				if (reader->open(filename))
+					return addReader(std::move(reader));
+				else
+					error_handler_.report(ErrorType::RUNTIME_ERROR, "File '" + filename + "' cannot be open", node->op.pos);
+			}
+			else
+				error_handler_.report(ErrorType::RUNTIME_ERROR, "OPENREAD parameter should be string", node->op.pos);
+		}
+		else if (op == TokenType::LISTDIR)
+		{
+			variant operand = visitNode(node->operand.get());
+
+			if (std::holds_alternative<std::string>(operand))
+			{
+				std::string dirname = std::get<std::string>(operand);
+				waitForJobs(dirname);
+
+				auto reader = std::make_unique<DirReader>();
+				if (reader->open(dirname))
+					return addReader(std::move(reader));
+				else
+					error_handler_.report(ErrorType::RUNTIME_ERROR, "Dir '" + dirname + "' cannot be open", node->op.pos);
+			}
+			else
+				error_handler_.report(ErrorType::RUNTIME_ERROR, "LISTDIR parameter should be string", node->op.pos);
+		}
+		else if (op == TokenType::REMOVETREE)
+		{
+			variant operand = visitNode(node->operand.get());
+
+			if (std::holds_alternative<std::string>(operand))
+			{
+				std::string dirname = std::get<std::string>(operand);
+				if (!isValidFileName(dirname))
+				{
+					error_handler_.report(ErrorType::RUNTIME_ERROR, "Dir '" + dirname + "' contains forbidden symbols", node->op.pos);
+					return variant();
+				}
+
+				waitForJobs(dirname);
+				files_.close(dirname);
+				reportFileErrors();
+				reads_.invalidate(dirname);
+
+				std::string error = trees_.remove(dirname);
+				if (!error.empty())
+					error_handler_.report(ErrorType::RUNTIME_ERROR, error, node->op.pos);
+			}
+			else
+				error_handler_.report(ErrorType::RUNTIME_ERROR, "REMOVETREE parameter should be string", node->op.pos);
+		}
+		else if (op == TokenType::READLINE || op == TokenType::END_OF_FILE)
+		{
+			variant operand = visitNode(node->operand.get());
+			LineSource* reader = getReader(operand);
+
+			if (!reader)
+				error_handler_.report(ErrorType::RUNTIME_ERROR, "The parameter is not a file opened by OPENREAD or LISTDIR", node->op.pos);
+			else if (op == TokenType::END_OF_FILE)
+				return reader->eof();
+			else
+			{
+				std::string line;
+				reader->readLine(line); // empty at the end of the file
+				return line;
+			}
+		}
+		else if (op == TokenType::CLOSE)
+		{
+			variant operand = visitNode(node->operand.get());
+
+			if (!getReader(operand))
+				error_handler_.report(ErrorType::RUNTIME_ERROR, "The parameter is not a file opened by OPENREAD or LISTDIR", node->op.pos);
+			else
+			{
+				int handle = std::get<int>(operand);
+				readers_[handle - 1].reset(); // closes the file, READLINE on the handle is an error now
+				free_readers_.push_back(handle);
+			}
+		}
+		else if (op == TokenType::AWAIT || op == TokenType::DONE)
+		{
+			variant operand = visitNode(node->operand.get());
+
+			if (!file_jobs_ || !std::holds_alternative<int>(operand) || !file_jobs_->valid(std::get<int>(operand)))
+				error_handler_.report(ErrorType::RUNTIME_ERROR, "The parameter is not a handle of an ASYNC file operation", node->op.pos);
+			else if (op == TokenType::DONE)
+				return file_jobs_->done(std::get<int>(operand));
+			else
+			{
+				int handle = std::get<int>(operand);
+				Scheduler::waitFor([&] { return file_jobs_->done(handle); }); // --multi: the other scripts go on meanwhile
+				std::string error = file_jobs_->await(handle);
+				if (!error.empty())
+					error_handler_.report(ErrorType::RUNTIME_ERROR, error, node->op.pos);
+
+				auto exec = exec_results_.find(handle);
+				if (exec != exec_results_.end()) // EXEC gives its output and sets EXITCODE, once
+				{
+					std::shared_ptr<ProcessResult> result = exec->second;
+					exec_results_.erase(exec);
+					exit_code_ = result->exit_code;
+					return result->output;
+				}
+				return error.empty();
+			}
+		}
 		else if (op == TokenType::CREATEDIR)
 		{
 			variant operand = visitNode(node->operand.get());
@@ -673,6 +975,8 @@ namespace kmsl
 					return variant();
 				}
 
+				waitForJobs(dirname);
+				reads_.invalidate(dirname);
 				std::filesystem::create_directory(dirname);
 			}
 			else
@@ -704,15 +1008,8 @@ namespace kmsl
 		{
 			auto variableNode = dynamic_cast<VariableNode*>(node->leftOperand.get());
 
-			auto it = std::find_if(variables_.begin(), variables_.end(), 
-				[&](const Variable& var) { return variableNode->token.text == var.name; });
-
 			variant valueNode = visitNode(node->rightOperand.get());
-
-			if (it != variables_.end()) 
-				it->value = valueNode;
-			else
-				variables_.emplace_back(valueNode, variableNode->token.text, deepness_);
+			setVariable(variableNode->token.text, valueNode);
 
 			break;
 		}
@@ -897,6 +1194,8 @@ namespace kmsl
 
 				if (times < 0)
 					error_handler_.report(ErrorType::RUNTIME_ERROR, "Cannot multiply string by a negative number", node->op.pos);
+				else if (!stringFits(var.size() * static_cast<size_t>(times), node->op.pos))
+					return std::string();
 
 				std::string string = var;
 				for (int i = 1; i < times; i++)
@@ -917,24 +1216,27 @@ namespace kmsl
 				if (std::holds_alternative<std::string>(leftValue))
 					left = std::get<std::string>(leftValue);
 				else if (std::holds_alternative<int>(leftValue))
-					left = std::to_string(std::get<int>(leftValue));
+					left = Convert::toString(std::get<int>(leftValue));
 				else if (std::holds_alternative<float>(leftValue))
-					left = std::to_string(std::get<float>(leftValue));
+					left = Convert::toString(std::get<float>(leftValue));
 				else if (std::holds_alternative<bool>(leftValue))
 					left = (std::get<bool>(leftValue)) ? "TRUE" : "FALSE";
 
 				if (std::holds_alternative<std::string>(rightValue))
 					right = std::get<std::string>(rightValue);
 				else if (std::holds_alternative<int>(rightValue))
-					right = std::to_string(std::get<int>(rightValue));
+					right = Convert::toString(std::get<int>(rightValue));
 				else if (std::holds_alternative<float>(rightValue))
-					right = std::to_string(std::get<float>(rightValue));
+					right = Convert::toString(std::get<float>(rightValue));
 				else if (std::holds_alternative<bool>(rightValue))
 					right = (std::get<bool>(rightValue)) ? "TRUE" : "FALSE";
 
 				switch (node->op.type)
 				{
-				case TokenType::PLUS: return left + right;
+				case TokenType::PLUS:
+					if (!stringFits(left.size() + right.size(), node->op.pos))
+						return std::string();
+					return left + right;
 				case TokenType::EQUALS: return left == right;
 				case TokenType::NOT_EQUALS: return left != right;
 				case TokenType::LESS_THAN: return left.length() < right.length();
@@ -973,8 +1275,11 @@ namespace kmsl
 			{
 				if (std::holds_alternative<std::string>(left))
 				{
-					std::string text = std::get<std::string>(left);
-					IoController::type(text, time);
+					InputEvent event;
+					event.type = InputEventType::TYPE;
+					event.text = std::get<std::string>(left);
+					event.time = time;
+					dispatchInput(std::move(event));
 				}
 				else
 					error_handler_.report(ErrorType::RUNTIME_ERROR, "The type parameter should be string", node->op.pos);
@@ -983,18 +1288,56 @@ namespace kmsl
 			{
 				if (std::holds_alternative<int>(left))
 				{
-					int amount = std::get<int>(left);
-					IoController::scroll(amount, time);
+					InputEvent event;
+					event.type = InputEventType::SCROLL;
+					event.x = std::get<int>(left);
+					event.time = time;
+					dispatchInput(std::move(event));
 				}
 				else
 					error_handler_.report(ErrorType::RUNTIME_ERROR, "The scroll parameter should be int", node->op.pos);
 			}
 			break;
 		}
+		case TokenType::REPLAY:
+		{
+			variant left = visitNode(node->leftOperand.get());
+			float speed = 1.f;
+
+			if (node->rightOperand)
+			{
+				variant right = visitNode(node->rightOperand.get());
+				if (std::holds_alternative<int>(right))
+					speed = static_cast<float>(std::get<int>(right));
+				else if (std::holds_alternative<float>(right))
+					speed = std::get<float>(right);
+				else
+					error_handler_.report(ErrorType::RUNTIME_ERROR, "The speed parameter should be int/float", node->op.pos);
+			}
+
+			if (!std::holds_alternative<std::string>(left))
+				error_handler_.report(ErrorType::RUNTIME_ERROR, "The replay parameter should be string", node->op.pos);
+			else if (speed <= 0)
+				error_handler_.report(ErrorType::RUNTIME_ERROR, "The replay speed should be greater than 0", node->op.pos);
+			else if (!InputReplayer::isLog(std::get<std::string>(left)))
+				error_handler_.report(ErrorType::RUNTIME_ERROR, "'" + std::get<std::string>(left) + "' is not an input recording", node->op.pos);
+			else
+			{
+				InputEvent event;
+				event.type = InputEventType::REPLAY;
+				event.text = std::get<std::string>(left);
+				event.time = speed;
+				dispatchInput(std::move(event));
+			}
+			break;
+		}
+		case TokenType::WAITUNTIL:
+			return waitUntil(node);
 		case TokenType::WRITEFILE:
 		case TokenType::APPENDFILE:
 		case TokenType::COPY:
 		case TokenType::RENAME:
+		case TokenType::COPYTREE:
 		{
 			variant left = visitNode(node->leftOperand.get());
 			variant right = visitNode(node->rightOperand.get());
@@ -1021,38 +1364,32 @@ namespace kmsl
 				return variant();
 			}
 
+			waitForJobs(filename);
+			if (node->op.type == TokenType::COPY || node->op.type == TokenType::RENAME || node->op.type == TokenType::COPYTREE)
+				waitForJobs(second);
+
 			switch (node->op.type)
 			{
 			case TokenType::WRITEFILE:
 			{
-				std::ofstream file(filename);
-
-				if (!file.is_open())
+				reads_.invalidate(filename);
+				if (!files_.write(filename, second, node->op.pos))
 					error_handler_.report(ErrorType::RUNTIME_ERROR, "File '" + filename + "' cannot be open", node->op.pos);
-				else
-				{
-					file << second;
-					file.close();
-				}
 
 				break;
 			}
 			case TokenType::APPENDFILE:
 			{
-				std::ofstream file;
-				file.open(filename, std::ios_base::app);
-
-				if (!file.is_open())
+				reads_.invalidate(filename);
+				if (!files_.append(filename, second, node->op.pos))
 					error_handler_.report(ErrorType::RUNTIME_ERROR, "File '" + filename + "' cannot be open", node->op.pos);
-				else
-				{
-					file << second;
-					file.close();
-				}
 
 				break;
 			}
 			case TokenType::COPY:
+				files_.flush(filename);
+				reads_.invalidate(second);
+
 				if (!std::filesystem::exists(filename))
 					error_handler_.report(ErrorType::RUNTIME_ERROR, "File '" + filename + "' cannot be found", node->op.pos);
 				else
@@ -1060,13 +1397,31 @@ namespace kmsl
 
 				break;
 			case TokenType::RENAME:
+				files_.close(filename);
+				files_.close(second);
+				reads_.invalidate(filename);
+				reads_.invalidate(second);
+
 				if (!std::filesystem::exists(filename))
 					error_handler_.report(ErrorType::RUNTIME_ERROR, "File '" + filename + "' cannot be found", node->op.pos);
 				else
 					std::filesystem::rename(filename, second);
 				
+				break;
+			case TokenType::COPYTREE:
+			{
+				files_.flushAll();
+				reads_.invalidate(second);
+
+				std::string error = trees_.copy(filename, second);
+				if (!error.empty())
+					error_handler_.report(ErrorType::RUNTIME_ERROR, error, node->op.pos);
+
 				break;
 			}
+			}
+
+			reportFileErrors(); // of the buffers which did not go out, of these files or of evicted ones
 		}
 
 		}
@@ -1094,6 +1449,8 @@ namespace kmsl
 		visitNode(node->initializerNode.get());
 		deepness_--;
 
+		Metrics::Loop metrics;
+		unsigned long long iterations = 0;
 		while (true)
 		{
 			variant conditionResult = visitNode(node->conditionNode.get());
@@ -1108,12 +1465,20 @@ namespace kmsl
 
 			visitNode(node->bodyNode.get());
 			visitNode(node->incrementNode.get());
+			metrics.next();
+			steps_++; // the jump back is a step, so an empty loop runs into --max-steps too
+
+			if (limited_ && limitReached(node->token.pos, "FOR", ++iterations))
+				break;
 		}
 		return variant();
 	}
 
 	variant Interpreter::visit(WhileNode* node)
 	{
+		Metrics::Loop metrics;
+		unsigned long long iterations = 0;
+		std::optional<PollBackoff> backoff;
 		while (true)
 		{
 			variant conditionResult = visitNode(node->conditionNode.get());
@@ -1128,75 +1493,236 @@ namespace kmsl
 			}
 
 			visitNode(node->bodyNode.get());
+			metrics.next();
+			iterations++;
+			steps_++; // the jump back is a step, so an empty loop runs into --max-steps too
+
+			if (limited_ && limitReached(node->token.pos, "WHILE", iterations))
+				break;
+
+			// a loop which only polls gets slower instead of keeping a core busy, the rest is not touched
+			if (backoff)
+				backoff->idle();
+			else if (iterations == 1000 && !strict_poll_)
+			{
+				int reads = pollReads(node->conditionNode.get()) | pollReads(node->bodyNode.get());
+				if (reads >= 0)
+				{
+					backoff.emplace(poll_stats_, poll_latency_, reads == POLL_INPUT);
+					output_.idle();
+				}
+			}
 		}
 		return variant();
 	}
 
-	variant Interpreter::visit(LiteralNode* node)
+	variant Interpreter::waitUntil(BinarOpNode* node)
 	{
-		DataType type = Symbol::convertType(node->token.type);
-		auto value = node->token.text;
-
-		std::stringstream ss(value);
-
-		switch (type)
-		{
-		case DataType::INT:
-		{
-			int intValue;
-			ss >> intValue;
-			if (ss.fail())
-				error_handler_.report(ErrorType::RUNTIME_ERROR, "Failed to convert string to int", node->token.pos);
-			return intValue;
-		}
-		case DataType::FLOAT:
+		auto until = std::chrono::steady_clock::time_point::max(); // without a timeout it waits as long as it takes
+		if (node->rightOperand)
 		{
-			float floatValue;
-			ss >> floatValue;
-			if (ss.fail())
-				error_handler_.report(ErrorType::RUNTIME_ERROR, "Failed to convert string to float", node->token.pos);
-			return floatValue;
+			variant timeout = visitNode(node->rightOperand.get());
+			float time = 0.f;
+			if (std::holds_alternative<int>(timeout))
+				time = static_cast<float>(std::get<int>(timeout));
+			else if (std::holds_alternative<float>(timeout))
+				time = std::get<float>(timeout);
+			else
+			{
+				error_handler_.report(ErrorType::RUNTIME_ERROR, "The timeout of WAITUNTIL should be int/float", node->op.pos);
+				return false;
+			}
+			until = std::chrono::steady_clock::now() + std::chrono::milliseconds(static_cast<int>(time * 1000));
 		}
-		case DataType::BOOL:
+
+		bool cut = until > deadline_; // --timeout ends during the WAITUNTIL
+		if (cut)
+			until = deadline_;
+
+		// only keys and the cursor: the condition is checked again on every input event and nothing else
+		int reads = pollReads(node->leftOperand.get());
+		bool on_input = reads == POLL_INPUT;
+		if (on_input)
+			InputState::start();
+
+		waituntil_stats_.waits++;
+		output_.idle();
+
+		std::optional<PollBackoff> backoff;
+		while (true)
 		{
-			if (value == "TRUE")
+			uint64_t seen = InputState::version(); // before the reads, so no change between them and the wait is lost
+			variant condition = visitNode(node->leftOperand.get());
+
+			if (!std::holds_alternative<bool>(condition))
+			{
+				error_handler_.report(ErrorType::RUNTIME_ERROR, "The condition of WAITUNTIL should be a boolean expression", node->op.pos);
+				return false;
+			}
+			if (std::get<bool>(condition))
 				return true;
-			else if (value == "FALSE")
+			if (exit_program_)
 				return false;
-			else
-				error_handler_.report(ErrorType::RUNTIME_ERROR, "Failed to convert string to bolean", node->token.pos);
-		}
-		case DataType::STRING:
-		{
-			return value;
-		}
+
+			auto now = std::chrono::steady_clock::now();
+			if (now >= until)
+				break;
+
+			if (!events_.empty() && !in_handler_ && error_handler_.getErrorsCount() == 0) // the handlers keep running, the condition is checked between them
+				runEvents(std::min(until, now + poll_latency_));
+			else if (on_input)
+			{
+				Scheduler::waitChange(seen, until);
+				if (InputState::version() != seen)
+					waituntil_stats_.wakeups++;
+			}
+			else // files, time, variables of the handlers: a spin first, then sleeps up to --poll-latency
+			{
+				if (!backoff)
+					backoff.emplace(poll_stats_, poll_latency_, false);
+				backoff->idle();
+			}
 		}
+
+		if (cut)
+			limitReached(node->op.pos, "in this WAITUNTIL", 0);
+		else
+			waituntil_stats_.timeouts++;
+		return false;
 	}
 
-	variant Interpreter::visit(KeyNode* node)
+	int Interpreter::pollReads(AstNode* node, bool assigned)
 	{
-		auto processButtons = [&](float& time) -> std::vector<std::string> {
-			std::vector<std::string> buttons;
+		auto combine = [](int a, int b) { return a < 0 || b < 0 ? -1 : a | b; };
 
-			if (!node->buttonNodes.empty())
-			{
-				auto lastNode = node->buttonNodes.back().get();
-				variant lastValue = visitNode(lastNode);
+		if (!node || dynamic_cast<LiteralNode*>(node))
+			return 0;
 
-				if (std::holds_alternative<int>(lastValue))
-				{
-					time = static_cast<float>(std::get<int>(lastValue));
-					node->buttonNodes.pop_back();
-				}
-				else if (std::holds_alternative<float>(lastValue))
-				{
-					time = std::get<float>(lastValue);
-					node->buttonNodes.pop_back();
-				}
+		if (auto variableNode = dynamic_cast<VariableNode*>(node))
+		{
+			switch (variableNode->token.type)
+			{
+			case TokenType::VARIABLE: return assigned ? -1 : 0; // x = x + 1 makes progress
+			case TokenType::RANDOM: return -1;
+			case TokenType::GETX: case TokenType::GETY: return POLL_INPUT;
+			case TokenType::YEAR: case TokenType::MONTH: case TokenType::WEEK: case TokenType::DAY:
+			case TokenType::HOUR: case TokenType::MINUTE: case TokenType::SECOND: case TokenType::MILLI: return POLL_TIME;
+			default: return 0;
 			}
+		}
 
-			for (const auto& btnNode : node->buttonNodes) {
-				variant button = visitNode(btnNode.get());
+		if (auto unarOpNode = dynamic_cast<UnarOpNode*>(node))
+		{
+			int operand = pollReads(unarOpNode->operand.get(), assigned);
+			switch (unarOpNode->op.type)
+			{
+			case TokenType::PLUS: case TokenType::MINUS: case TokenType::LOGICAL_NOT: case TokenType::BIT_NOT:
+			case TokenType::SIN: case TokenType::COS: case TokenType::TAN: case TokenType::ASIN: case TokenType::ACOS:
+			case TokenType::ATAN: case TokenType::ABS: case TokenType::RCEIL: case TokenType::RFLOOR: return operand;
+			case TokenType::STATE: return combine(operand, POLL_INPUT);
+			case TokenType::EXISTS: case TokenType::READFILE: case TokenType::END_OF_FILE: case TokenType::DONE: return combine(operand, POLL_FILES);
+			default: return -1;
+			}
+		}
+
+		if (auto binarOpNode = dynamic_cast<BinarOpNode*>(node))
+		{
+			if (binarOpNode->op.type == TokenType::ASSIGN) // x = GETX, the same value until the outside changes
+				return pollReads(binarOpNode->rightOperand.get(), true);
+
+			switch (binarOpNode->op.type)
+			{
+			case TokenType::PLUS: case TokenType::MINUS: case TokenType::MULTIPLY: case TokenType::DIVIDE: case TokenType::FLOOR:
+			case TokenType::MODULO: case TokenType::ROOT: case TokenType::LOG: case TokenType::POWER:
+			case TokenType::BIT_AND: case TokenType::BIT_OR: case TokenType::BIT_XOR: case TokenType::BIT_LEFT_SHIFT: case TokenType::BIT_RIGHT_SHIFT:
+			case TokenType::LOGICAL_AND: case TokenType::LOGICAL_OR: case TokenType::EQUALS: case TokenType::NOT_EQUALS:
+			case TokenType::LESS_THAN: case TokenType::GREATER_THAN: case TokenType::LESS_THAN_OR_EQUAL: case TokenType::GREATER_THAN_OR_EQUAL:
+				return combine(pollReads(binarOpNode->leftOperand.get(), assigned), pollReads(binarOpNode->rightOperand.get(), assigned));
+			default:
+				return -1;
+			}
+		}
+
+		if (auto ifNode = dynamic_cast<IfNode*>(node))
+			return combine(pollReads(ifNode->conditionNode.get()),
+				combine(pollReads(ifNode->thenBranchNode.get()), pollReads(ifNode->elseBranchNode.get())));
+
+		if (auto blockNode = dynamic_cast<BlockNode*>(node))
+		{
+			int reads = 0;
+			for (auto& stmt : blockNode->getStatements())
+				reads = combine(reads, pollReads(stmt.get()));
+			return reads;
+		}
+
+		if (auto commandNode = dynamic_cast<CommandNode*>(node))
+			return commandNode->type.type == TokenType::BREAK || commandNode->type.type == TokenType::CONTINUE ||
+				commandNode->type.type == TokenType::EXIT ? 0 : -1;
+
+		return -1; // input, EXEC, ASYNC, inner loops etc.
+	}
+
+	variant Interpreter::visit(LiteralNode* node)
+	{
+		DataType type = Symbol::convertType(node->token.type);
+		auto value = node->token.text;
+
+		switch (type)
+		{
+		case DataType::INT:
+		{
+			int intValue = 0;
+			if (!Convert::parseInt(value, intValue))
+				error_handler_.report(ErrorType::RUNTIME_ERROR, "Failed to convert string to int", node->token.pos);
+			return intValue;
+		}
+		case DataType::FLOAT:
+		{
+			float floatValue = 0.f;
+			if (!Convert::parseFloat(value, floatValue))
+				error_handler_.report(ErrorType::RUNTIME_ERROR, "Failed to convert string to float", node->token.pos);
+			return floatValue;
+		}
+		case DataType::BOOL:
+		{
+			if (value == "TRUE")
+				return true;
+			else if (value == "FALSE")
+				return false;
+			else
+				error_handler_.report(ErrorType::RUNTIME_ERROR, "Failed to convert string to bolean", node->token.pos);
+		}
+		case DataType::STRING:
+		{
+			return value;
+		}
+		}
+	}
+
+	variant Interpreter::visit(KeyNode* node)
+	{
+		auto processButtons = [&](float& time) -> std::vector<std::string> {
+			std::vector<std::string> buttons;
+
+			std::vector<variant> values; // the tree is shared, so a time at the end is left out here instead of in the node
+			for (const auto& btnNode : node->buttonNodes)
+				values.push_back(visitNode(btnNode.get()));
+
+			if (!values.empty())
+			{
+				if (std::holds_alternative<int>(values.back()))
+				{
+					time = static_cast<float>(std::get<int>(values.back()));
+					values.pop_back();
+				}
+				else if (std::holds_alternative<float>(values.back()))
+				{
+					time = std::get<float>(values.back());
+					values.pop_back();
+				}
+			}
+
+			for (const variant& button : values) {
 				if (std::holds_alternative<std::string>(button))
 					buttons.emplace_back(std::get<std::string>(button));
 				else
@@ -1211,19 +1737,24 @@ namespace kmsl
 		{
 		case TokenType::PRESS:
 		{
-			auto buttons = processButtons(time);
-			IoController::press(buttons, time);
+			InputEvent event;
+			event.type = InputEventType::PRESS;
+			event.buttons = processButtons(time);
+			event.time = time;
+			dispatchInput(std::move(event));
 			break;
 		}
 		case TokenType::HOLD:
 		{
 			auto buttons = processButtons(time);
+			syncInput();
 			IoController::hold(buttons);
 			break;
 		}
 		case TokenType::RELEASE:
 		{
 			auto buttons = processButtons(time);
+			syncInput();
 			IoController::release(buttons);
 			break;
 		}
@@ -1262,14 +1793,10 @@ namespace kmsl
 		};
 
 
-		int x, y;
-		float time = 0;
-		setValues(x, y, time);
-
-		if (node->token.type == TokenType::MOVE)
-			IoController::moveTo(x, y, time);
-		else
-			IoController::moveBy(x, y, time);
+		InputEvent event;
+		event.type = node->token.type == TokenType::MOVE ? InputEventType::MOVE : InputEventType::DMOVE;
+		setValues(event.x, event.y, event.time);
+		dispatchInput(std::move(event));
 
 		return variant();
 	}
@@ -1282,6 +1809,80 @@ namespace kmsl
 			continue_loop_ = true;
 		else if (node->type.type == TokenType::EXIT)
 			exit_program_ = true;
+		else if (node->type.type == TokenType::SYNC)
+		{
+			syncInput();
+			syncFiles();
+			reportFileErrors();
+		}
+		else if (node->type.type == TokenType::FLUSH)
+		{
+			files_.flushAll();
+			reportFileErrors();
+		}
+		return variant();
+	}
+
+	variant Interpreter::visit(AsyncNode* node)
+	{
+		if (isFileStatement(node->statement.get()))
+			return startFileJob(node->statement.get());
+		if (auto execNode = dynamic_cast<ExecNode*>(node->statement.get()))
+			return startExec(execNode);
+
+		async_input_ = true;
+		visitNode(node->statement.get());
+		async_input_ = false;
+
+		return variant();
+	}
+
+	variant Interpreter::visit(TriggerNode* node)
+	{
+		variant argument = visitNode(node->argumentNode.get());
+
+		if (node->token.type == TokenType::ON)
+		{
+			if (!std::holds_alternative<std::string>(argument))
+			{
+				error_handler_.report(ErrorType::RUNTIME_ERROR, "ON KEY parameter should be string", node->token.pos);
+				return variant();
+			}
+
+			std::string key = std::get<std::string>(argument);
+			WORD keyCode = IoController::getVirtualKeyCode(key);
+			if (keyCode == 0)
+			{
+				error_handler_.report(ErrorType::RUNTIME_ERROR, "Unknown key '" + key + "'", node->token.pos);
+				return variant();
+			}
+
+			events_.onKey(node, keyCode, node->bodyNode->clone());
+		}
+		else
+		{
+			float interval;
+
+			if (std::holds_alternative<int>(argument))
+				interval = static_cast<float>(std::get<int>(argument));
+			else if (std::holds_alternative<float>(argument))
+				interval = std::get<float>(argument);
+			else
+			{
+				error_handler_.report(ErrorType::RUNTIME_ERROR, "EVERY parameter should be int/float", node->token.pos);
+				return variant();
+			}
+
+			if (interval <= 0)
+			{
+				error_handler_.report(ErrorType::RUNTIME_ERROR, "EVERY interval should be greater than 0", node->token.pos);
+				return variant();
+			}
+
+			auto duration = std::chrono::duration_cast<EventLoop::clock::duration>(std::chrono::duration<float>(interval));
+			events_.every(node, duration, node->bodyNode->clone());
+		}
+
 		return variant();
 	}
 
@@ -1292,8 +1893,25 @@ namespace kmsl
 		auto variableNode = dynamic_cast<VariableNode*>(node->leftOperand.get());
 
 		std::string text = node->op.text.substr(0, node->op.text.size() - 1); // delete the =
-		Lexer l(text); // get the type
-		Token newToken = Token(l.scanTokens()[0].type, text, node->op.pos);
+		TokenType type;
+		switch (node->op.type) // not with a Lexer, that compiled its regexes again on every run
+		{
+		case TokenType::PLUS_ASSIGN: type = TokenType::PLUS; break;
+		case TokenType::MINUS_ASSIGN: type = TokenType::MINUS; break;
+		case TokenType::MULTIPLY_ASSIGN: type = TokenType::MULTIPLY; break;
+		case TokenType::DIVIDE_ASSIGN: type = TokenType::DIVIDE; break;
+		case TokenType::MODULO_ASSIGN: type = TokenType::MODULO; break;
+		case TokenType::FLOOR_ASSIGN: type = TokenType::FLOOR; break;
+		case TokenType::POWER_ASSIGN: type = TokenType::POWER; break;
+		case TokenType::ROOT_ASSIGN: type = TokenType::ROOT; break;
+		case TokenType::LOG_ASSIGN: type = TokenType::LOG; break;
+		case TokenType::BIT_AND_ASSIGN: type = TokenType::BIT_AND; break;
+		case TokenType::BIT_OR_ASSIGN: type = TokenType::BIT_OR; break;
+		case TokenType::BIT_XOR_ASSIGN: type = TokenType::BIT_XOR; break;
+		case TokenType::BIT_LEFT_SHIFT_ASSIGN: type = TokenType::BIT_LEFT_SHIFT; break;
+		default: type = TokenType::BIT_RIGHT_SHIFT; break;
+		}
+		Token newToken = Token(type, text, node->op.pos);
 
 		std::unique_ptr<BinarOpNode> newNode(std::make_unique<BinarOpNode>(newToken, node->leftOperand->clone(), node->rightOperand->clone()));
 		std::unique_ptr<BinarOpNode> fullNewNode(std::make_unique<BinarOpNode>(Token(TokenType::ASSIGN, "=", node->op.pos), node->leftOperand->clone(), std::move(newNode)));
@@ -1311,4 +1929,514 @@ namespace kmsl
 		const std::string forbidden_symbols = "\\ / : * ? \" < > |";
 		return name.find_first_of(forbidden_symbols) == std::string::npos;
 	}
+
+	LineSource* Interpreter::getReader(const variant& handle)
+	{
+		if (!std::holds_alternative<int>(handle))
+			return nullptr;
+
+		int n = std::get<int>(handle);
+		if (n < 1 || n > static_cast<int>(readers_.size()))
+			return nullptr;
+
+		return readers_[n - 1].get();
+	}
+
+	int Interpreter::addReader(std::unique_ptr<LineSource> reader)
+	{
+		if (free_readers_.empty())
+		{
+			readers_.push_back(std::move(reader));
+			return static_cast<int>(readers_.size());
+		}
+
+		int handle = free_readers_.back();
+		free_readers_.pop_back();
+		readers_[handle - 1] = std::move(reader);
+		return handle;
+	}
+
+	bool Interpreter::isInputStatement(AstNode* node)
+	{
+		if (dynamic_cast<MouseNode*>(node) || dynamic_cast<KeyNode*>(node))
+			return true;
+
+		if (auto binarOpNode = dynamic_cast<BinarOpNode*>(node))
+			return binarOpNode->op.type == TokenType::TYPE || binarOpNode->op.type == TokenType::SCROLL || binarOpNode->op.type == TokenType::REPLAY;
+
+		return false;
+	}
+
+	bool Interpreter::isBuiltinCall(AstNode* node)
+	{
+		if (dynamic_cast<MouseNode*>(node) || dynamic_cast<KeyNode*>(node) || dynamic_cast<ExecNode*>(node))
+			return true;
+
+		// the builtins are words, the operators are not
+		const Token* op = nullptr;
+		if (auto unarOpNode = dynamic_cast<UnarOpNode*>(node))
+			op = &unarOpNode->op;
+		else if (auto binarOpNode = dynamic_cast<BinarOpNode*>(node))
+			op = &binarOpNode->op;
+
+		return op && !op->text.empty() && std::isalpha(static_cast<unsigned char>(op->text[0]));
+	}
+
+	void Interpreter::dispatchInput(InputEvent event)
+	{
+		if (async_input_)
+		{
+			if (!input_dispatcher_)
+				input_dispatcher_ = std::make_unique<InputDispatcher>();
+
+			IoController::sendPending(); // the batched input comes first
+			input_dispatcher_->push(std::move(event));
+		}
+		else
+		{
+			syncInput(); // keeps the order of ASYNC and blocking input
+			InputDispatcher::execute(event);
+		}
+	}
+
+	void Interpreter::syncInput()
+	{
+		if (input_dispatcher_)
+			input_dispatcher_->sync();
+	}
+
+	variant Interpreter::visit(ExecNode* node)
+	{
+		if (Scheduler::active()) // --multi: the process runs like ASYNC EXEC, so the other scripts go on meanwhile
+		{
+			variant handle = startExec(node);
+			if (!std::holds_alternative<int>(handle))
+				return variant();
+
+			int h = std::get<int>(handle);
+			Scheduler::waitFor([&] { return file_jobs_->done(h); });
+			std::string error = file_jobs_->await(h);
+			if (!error.empty())
+				error_handler_.report(ErrorType::RUNTIME_ERROR, error, node->token.pos);
+
+			std::shared_ptr<ProcessResult> result = exec_results_[h];
+			exec_results_.erase(h);
+			exit_code_ = result->exit_code;
+			return result->output;
+		}
+
+		std::vector<std::string> argv;
+		double timeout;
+		if (!execArguments(node, argv, timeout))
+			return variant();
+
+		output_.flush(); // the program writes its stderr to the same terminal
+		files_.flushAll(); // and may read our files
+
+		ProcessResult result = Process::run(argv, timeout);
+		if (!result.error.empty())
+			error_handler_.report(ErrorType::RUNTIME_ERROR, result.error, node->token.pos);
+
+		exit_code_ = result.exit_code;
+		return result.output;
+	}
+
+	bool Interpreter::execArguments(ExecNode* node, std::vector<std::string>& argv, double& timeout)
+	{
+		timeout = 0;
+
+		for (size_t i = 0; i < node->argumentNodes.size(); i++)
+		{
+			variant argument = visitNode(node->argumentNodes[i].get());
+			bool last = i + 1 == node->argumentNodes.size();
+
+			if (std::holds_alternative<std::string>(argument))
+				argv.push_back(std::get<std::string>(argument));
+			else if (last && i > 0 && (std::holds_alternative<int>(argument) || std::holds_alternative<float>(argument)))
+				timeout = std::holds_alternative<int>(argument) ? std::get<int>(argument) : std::get<float>(argument);
+			else
+			{
+				error_handler_.report(ErrorType::RUNTIME_ERROR, "EXEC takes the program and its arguments as strings, only the timeout at the end is a number", node->token.pos);
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	variant Interpreter::startExec(ExecNode* node)
+	{
+		std::vector<std::string> argv;
+		double timeout;
+		if (!execArguments(node, argv, timeout))
+			return variant();
+
+		output_.flush();
+		files_.flushAll();
+
+		if (!file_jobs_)
+			file_jobs_ = std::make_unique<FileJobs>();
+
+		auto result = std::make_shared<ProcessResult>();
+		int handle = file_jobs_->submitOwnThread(static_cast<size_t>(node->token.pos), [result, argv, timeout]()
+		{
+			*result = Process::run(argv, timeout);
+			return result->error;
+		});
+
+		exec_results_[handle] = result;
+		return handle;
+	}
+
+	bool Interpreter::isFileStatement(AstNode* node)
+	{
+		if (auto binarOpNode = dynamic_cast<BinarOpNode*>(node))
+			return binarOpNode->op.type == TokenType::WRITEFILE || binarOpNode->op.type == TokenType::APPENDFILE ||
+				binarOpNode->op.type == TokenType::COPY || binarOpNode->op.type == TokenType::RENAME ||
+				binarOpNode->op.type == TokenType::COPYTREE;
+
+		if (auto unarOpNode = dynamic_cast<UnarOpNode*>(node))
+			return unarOpNode->op.type == TokenType::CREATEFILE || unarOpNode->op.type == TokenType::REMOVE ||
+				unarOpNode->op.type == TokenType::CREATEDIR || unarOpNode->op.type == TokenType::REMOVETREE;
+
+		return false;
+	}
+
+	bool Interpreter::isFileOperation(AstNode* node)
+	{
+		if (isFileStatement(node))
+			return true;
+
+		if (auto unarOpNode = dynamic_cast<UnarOpNode*>(node))
+			return unarOpNode->op.type == TokenType::READFILE || unarOpNode->op.type == TokenType::EXISTS ||
+				unarOpNode->op.type == TokenType::OPENREAD || unarOpNode->op.type == TokenType::READLINE ||
+				unarOpNode->op.type == TokenType::END_OF_FILE || unarOpNode->op.type == TokenType::LISTDIR ||
+				unarOpNode->op.type == TokenType::CLOSE;
+
+		return false;
+	}
+
+	variant Interpreter::startFileJob(AstNode* node)
+	{
+		Token op;
+		std::string filename, second;
+
+		if (auto binarOpNode = dynamic_cast<BinarOpNode*>(node))
+		{
+			op = binarOpNode->op;
+			variant left = visitNode(binarOpNode->leftOperand.get());
+			variant right = visitNode(binarOpNode->rightOperand.get());
+
+			if (!std::holds_alternative<std::string>(left) || !std::holds_alternative<std::string>(right))
+			{
+				error_handler_.report(ErrorType::RUNTIME_ERROR, "Filename and text parameters should be string", op.pos);
+				return variant();
+			}
+
+			filename = std::get<std::string>(left);
+			second = std::get<std::string>(right);
+		}
+		else if (auto unarOpNode = dynamic_cast<UnarOpNode*>(node))
+		{
+			op = unarOpNode->op;
+			variant operand = visitNode(unarOpNode->operand.get());
+
+			if (!std::holds_alternative<std::string>(operand))
+			{
+				error_handler_.report(ErrorType::RUNTIME_ERROR, op.text + " parameter should be string", op.pos);
+				return variant();
+			}
+
+			filename = std::get<std::string>(operand);
+		}
+
+		bool two_paths = op.type == TokenType::COPY || op.type == TokenType::RENAME || op.type == TokenType::COPYTREE;
+		std::vector<std::string> paths = two_paths ? std::vector<std::string>{ filename, second } : std::vector<std::string>{ filename };
+
+		for (const std::string& path : paths)
+		{
+			if (!isValidFileName(path))
+			{
+				error_handler_.report(ErrorType::RUNTIME_ERROR, "File '" + path + "' contains forbidden symbols", op.pos);
+				return variant();
+			}
+		}
+
+		// the job bypasses both caches, so they give up the files first
+		if (op.type == TokenType::COPYTREE)
+			files_.flushAll();
+		else if (op.type == TokenType::COPY)
+			files_.flush(filename);
+		else
+			files_.close(filename);
+		reads_.invalidate(filename);
+
+		if (two_paths)
+		{
+			files_.close(second);
+			reads_.invalidate(second);
+		}
+		reportFileErrors();
+
+		FileJobs::Job job;
+		switch (op.type)
+		{
+		case TokenType::WRITEFILE:
+		case TokenType::APPENDFILE:
+		{
+			bool append = op.type == TokenType::APPENDFILE;
+			AtomicWriter* atomic = files_.atomic(); // outlives the jobs, they are awaited before files_ goes
+			long long pos = op.pos;
+			job = [filename, second, append, atomic, pos]() -> std::string
+			{
+				if (atomic && !append) // the same temp file, rename and group commit as a plain WRITEFILE
+					return atomic->write(filename, second, pos) ? "" : "File '" + filename + "' cannot be open";
+				if (atomic)
+					atomic->commit(filename); // another job may have left a pending write of it
+
+				std::ofstream file(filename, append ? std::ios_base::app : std::ios_base::out);
+				if (!file.is_open())
+					return "File '" + filename + "' cannot be open";
+
+				file << second;
+				return "";
+			};
+			break;
+		}
+		case TokenType::CREATEFILE:
+			job = [filename]() -> std::string
+			{
+				std::ofstream file(filename);
+				return file.is_open() ? "" : "File '" + filename + "' cannot be created";
+			};
+			break;
+		case TokenType::CREATEDIR:
+			job = [filename]() -> std::string
+			{
+				std::error_code ec;
+				std::filesystem::create_directory(filename, ec);
+				return ec ? "Dir '" + filename + "' cannot be created: " + ec.message() : "";
+			};
+			break;
+		case TokenType::REMOVE:
+			job = [filename]() -> std::string
+			{
+				if (!std::filesystem::exists(filename))
+					return "File '" + filename + "' does not exists";
+
+				std::error_code ec;
+				std::filesystem::remove(filename, ec);
+				return ec ? "File '" + filename + "' cannot be removed: " + ec.message() : "";
+			};
+			break;
+		case TokenType::COPY:
+		case TokenType::RENAME:
+		{
+			bool copy = op.type == TokenType::COPY;
+			job = [filename, second, copy]() -> std::string
+			{
+				if (!std::filesystem::exists(filename))
+					return "File '" + filename + "' cannot be found";
+
+				std::error_code ec;
+				if (copy)
+					std::filesystem::copy(filename, second, ec);
+				else
+					std::filesystem::rename(filename, second, ec);
+				return ec ? "File '" + filename + "' cannot be " + (copy ? "copied: " : "renamed: ") + ec.message() : "";
+			};
+			break;
+		}
+		case TokenType::COPYTREE:
+		{
+			FileTree* trees = &trees_;
+			job = [trees, filename, second]() { return trees->copy(filename, second); };
+			break;
+		}
+		case TokenType::REMOVETREE:
+		{
+			FileTree* trees = &trees_;
+			job = [trees, filename]() { return trees->remove(filename); };
+			break;
+		}
+		default:
+			return variant();
+		}
+
+		if (!file_jobs_)
+			file_jobs_ = std::make_unique<FileJobs>();
+
+		return file_jobs_->submit(paths, static_cast<size_t>(op.pos), std::move(job));
+	}
+
+	void Interpreter::waitForJobs(const std::string& path)
+	{
+		if (!file_jobs_)
+			return;
+
+		Scheduler::waitFor([&] { return file_jobs_->idle(path); }); // --multi: the other scripts go on meanwhile
+		file_jobs_->waitFor(path);
+	}
+
+	void Interpreter::syncFiles()
+	{
+		if (!file_jobs_)
+			return;
+
+		Scheduler::waitFor([&] { return file_jobs_->idle(); });
+		file_jobs_->waitAll();
+		for (const auto& error : file_jobs_->takeErrors())
+			error_handler_.report(ErrorType::RUNTIME_ERROR, error.second, static_cast<long long>(error.first));
+	}
+
+	void Interpreter::reportFileErrors()
+	{
+		for (const auto& error : files_.takeErrors())
+			error_handler_.report(ErrorType::RUNTIME_ERROR, error.second, error.first);
+	}
+
+	void Interpreter::runEvents(std::chrono::steady_clock::time_point until)
+	{
+		in_handler_ = true;
+
+		while (!exit_program_ && error_handler_.getErrorsCount() == 0)
+		{
+			output_.idle();
+			std::vector<std::shared_ptr<AstNode>> due = events_.wait(until);
+			if (due.empty()) // until has passed
+				break;
+
+			for (const auto& body : due)
+			{
+				if (exit_program_)
+					break;
+
+				visitNode(body.get());
+			}
+		}
+
+		in_handler_ = false;
+	}
+
+	void Interpreter::setLimits(unsigned long long max_steps, double timeout, size_t max_memory)
+	{
+		max_steps_ = max_steps;
+		timeout_ = timeout;
+		deadline_ = timeout > 0 ? std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(timeout))
+			: std::chrono::steady_clock::time_point::max();
+		max_memory_ = max_memory;
+		limited_ = max_steps_ > 0 || timeout_ > 0 || max_memory_ > 0;
+	}
+
+	bool Interpreter::limitReached(long long pos, const char* where, unsigned long long iterations)
+	{
+		std::string reason;
+		if (max_steps_ && steps_ > max_steps_)
+			reason = "--max-steps " + std::to_string(max_steps_) + " reached";
+		else if (timeout_ > 0 && std::chrono::steady_clock::now() >= deadline_)
+			reason = "--timeout of " + Convert::toString(static_cast<float>(timeout_)) + " s reached after " + std::to_string(steps_) + " steps";
+		else if (max_memory_ && string_bytes_ > max_memory_)
+			reason = "--max-memory of " + std::to_string(max_memory_) + " bytes reached, the strings hold " + std::to_string(string_bytes_) + " bytes";
+		else
+			return false;
+
+		if (iterations > 0)
+			reason += " in this " + std::string(where) + " loop after " + std::to_string(iterations) + " iterations";
+		else
+			reason += ' ' + std::string(where);
+
+		error_handler_.report(ErrorType::RUNTIME_ERROR, "The script was stopped: " + reason, pos);
+		exit_program_ = true;
+		return true;
+	}
+
+	bool Interpreter::stringFits(size_t bytes, long long pos)
+	{
+		if (!max_memory_ || string_bytes_ + bytes <= max_memory_)
+			return true;
+
+		error_handler_.report(ErrorType::RUNTIME_ERROR, "The script was stopped: --max-memory of " + std::to_string(max_memory_) +
+			" bytes reached, a string of " + std::to_string(bytes) + " bytes was made while the strings hold " + std::to_string(string_bytes_) + " bytes", pos);
+		exit_program_ = true;
+		return false;
+	}
+
+	void Interpreter::setVariable(const std::string& name, const variant& value)
+	{
+		auto it = std::find_if(variables_.begin(), variables_.end(),
+			[&](const Variable& var) { return name == var.name; });
+
+		if (max_memory_)
+			string_bytes_ += stringBytes(value) - (it != variables_.end() ? stringBytes(it->value) : 0);
+
+		if (it != variables_.end())
+			it->value = value;
+		else
+			variables_.emplace_back(value, name, deepness_);
+	}
+
+	void Interpreter::printStats(std::ostream& os)
+	{
+		if (!stats_enabled_)
+			return;
+
+		output_.flush(); // the stats follow the output of the script
+
+		if (stats_json_) // only the pipeline, to compare runs
+		{
+			phases_.printJson(os);
+			return;
+		}
+
+		os << "STATS:" << std::endl;
+		phases_.print(os);
+
+		if (input_dispatcher_)
+			input_dispatcher_->printStats(os);
+		else
+			os << "input dispatcher: not used" << std::endl;
+
+		IoController::printStats(os);
+		output_.printStats(os);
+		files_.printStats(os);
+		reads_.printStats(os);
+
+		if (trees_.used())
+			trees_.printStats(os);
+		else
+			os << "file trees: not used" << std::endl;
+
+		if (file_jobs_)
+			file_jobs_->printStats(os);
+		else
+			os << "file jobs: not used" << std::endl;
+
+		if (!events_.empty())
+			events_.printStats(os);
+		else
+			os << "event loop: not used" << std::endl;
+
+		if (strict_poll_)
+			os << "busy-wait backoff: off (--strict-poll)" << std::endl;
+		else if (poll_stats_.loops > 0)
+			poll_stats_.print(os);
+		else
+			os << "busy-wait backoff: not used" << std::endl;
+
+		if (waituntil_stats_.waits > 0)
+			os << "waituntil: " << waituntil_stats_.waits << " waits, " << waituntil_stats_.wakeups << " input wakeups, "
+				<< waituntil_stats_.timeouts << " timed out" << std::endl;
+		else
+			os << "waituntil: not used" << std::endl;
+
+		if (streaming_)
+			os << "stream: " << stream_statements_ << " statements from " << stream_lines_ << " lines" << std::endl;
+		else
+			os << "stream: not used" << std::endl;
+
+		if (Trace::enabled())
+			Trace::printStats(os);
+		else
+			os << "trace: not used" << std::endl;
+	}
 }
@@ -13,6 +13,8 @@
 #include <fstream>
 #include <filesystem>
 #include <cmath>
+#include <optional>
+#include <random>
 
 #include "../AST/ast.hpp"
 #include "../lexer/Lexer.hpp"
@@ -21,7 +23,25 @@
 #include "../semantic/SemanticAnalyzer.hpp"
 #include "../semantic/SymbolTable.hpp"
 #include "../io/IoController.hpp"
+#include "../io/InputDispatcher.hpp"
+#include "../io/OutputSink.hpp"
+#include "../io/Process.hpp"
+#include "../io/Trace.hpp"
+#include "../io/Metrics.hpp"
 #include "FileReader.hpp"
+#include "EventLoop.hpp"
+#include "Convert.hpp"
+#include "FileCache.hpp"
+#include "LineReader.hpp"
+#include "ReadCache.hpp"
+#include "FileJobs.hpp"
+#include "FileTree.hpp"
+#include "StatementReader.hpp"
+#include "Profiler.hpp"
+#include "PhaseStats.hpp"
+#include "PollBackoff.hpp"
+#include "Scheduler.hpp"
+#include "Program.hpp"
 #include "../error/ErrorHandler.hpp"
 
 namespace kmsl
@@ -30,6 +50,9 @@ namespace kmsl
 
 	struct Variable
 	{
+		Variable(const variant& v, const std::string& n, unsigned short d)
+			: value(v), name(n), deepness(d) {}
+
 		variant value;
 		std::string name;
 		unsigned short deepness;
@@ -43,9 +66,26 @@ namespace kmsl
 
 		void execute();
 		void runConsole();
+		void runStream(std::istream& in); // kmsl -: runs every statement as soon as it is read
 
 		void setLoggingEnabled(bool logging_enabled) { logging_enabled_ = logging_enabled; }
+		void setStatsEnabled(bool stats_enabled) { stats_enabled_ = stats_enabled; phases_.setCounting(stats_enabled); }
+		void setStatsJson(bool stats_json) { stats_json_ = stats_json; }
+		void setOutputThreadEnabled(bool enabled) { output_.setWriterThread(enabled); }
+		void setReadCacheEnabled(bool enabled) { reads_.setEnabled(enabled); }
+		void setAtomicWriteEnabled(bool enabled) { files_.setAtomic(enabled); }
+		void setProfileEnabled(bool enabled) { profiler_.setEnabled(enabled); }
+		// --max-steps (statements), --timeout (seconds, from now) and --max-memory (bytes of strings), 0 = no limit
+		void setLimits(unsigned long long max_steps, double timeout, size_t max_memory);
+		// --strict-poll keeps polling loops at full speed, otherwise they back off up to latency
+		void setPolling(bool strict, std::chrono::microseconds latency) { strict_poll_ = strict; poll_latency_ = latency; }
 		void setCode(const std::string& c, bool auto_visit = false); // auto_visit for DO
+		void setProgram(std::shared_ptr<const Program> program); // instead of setCode, the program is shared and only read
+		bool hasErrors() const { return has_errors_; } // after execute(): syntax, semantic or runtime errors
+
+		void printStats(std::ostream& os);
+		void printProfile(std::ostream& os, size_t top) const { profiler_.printTop(os, top); }
+		void writeFoldedProfile(std::ostream& os, const std::string& root = "kmsl") const { profiler_.writeFolded(os, root); }
 
 	private:
 		variant visitNode(AstNode* node);
@@ -60,6 +100,12 @@ namespace kmsl
 		variant visit(KeyNode* node);
 		variant visit(MouseNode* node);
 		variant visit(CommandNode* node);
+		variant visit(AsyncNode* node);
+		variant visit(TriggerNode* node);
+		variant visit(ExecNode* node);
+
+		// waits for the ASYNC work, writes the output and shows the errors at the end of a script
+		void finish();
 
 		// a o= n -----> a = a o n (o - operator)
 		void expand_argumented_assigments(BinarOpNode* node);
@@ -69,11 +115,69 @@ namespace kmsl
 
 		// checks file name
 		bool isValidFileName(const std::string& name);
+
+		// the reader of an OPENREAD or LISTDIR handle, nullptr if there is none
+		LineSource* getReader(const variant& handle);
+		int addReader(std::unique_ptr<LineSource> reader); // the handle, a slot freed by CLOSE is used again
+
+		// ASYNC COPY, WRITEFILE etc., returns the handle for AWAIT and DONE
+		bool isFileStatement(AstNode* node);
+		bool isFileOperation(AstNode* node); // the statements above and READFILE, EXISTS, LISTDIR, CLOSE etc., for --metrics
+		variant startFileJob(AstNode* node);
+		// program, arguments and the optional timeout of EXEC, false after an error
+		bool execArguments(ExecNode* node, std::vector<std::string>& argv, double& timeout);
+		variant startExec(ExecNode* node); // ASYNC EXEC
+		// blocking operations on a file wait for its ASYNC jobs
+		void waitForJobs(const std::string& path);
+		// waits for all ASYNC file jobs (SYNC, end of the script), reports the errors nobody AWAITed
+		void syncFiles();
+		// writes which failed after their statement, in the atomic commit (FLUSH, SYNC, end of the script)
+		void reportFileErrors();
+
+		// MOVE, PRESS, TYPE etc., consecutive ones share one input batch
+		bool isInputStatement(AstNode* node);
+		// PRINT, READFILE, WAIT, MOVE, EXEC etc., they get their own span in --trace
+		static bool isBuiltinCall(AstNode* node);
+
+		// runs the event on the dispatcher thread inside ASYNC, otherwise right here
+		void dispatchInput(InputEvent event);
+		// waits for all ASYNC input (SYNC and before any blocking input)
+		void syncInput();
+
+		// runs ON KEY and EVERY handlers until `until`, EXIT or an error
+		void runEvents(std::chrono::steady_clock::time_point until);
+
+		// checked at the back-edges of the loops, a hit limit is reported where the script is and ends it
+		// where is FOR or WHILE with their iterations, otherwise the rest of the message ("in this WAIT")
+		bool limitReached(long long pos, const char* where, unsigned long long iterations);
+		bool stringFits(size_t bytes, long long pos); // a new string value within --max-memory
+		void setVariable(const std::string& name, const variant& value);
+		static size_t stringBytes(const variant& value) { return std::holds_alternative<std::string>(value) ? std::get<std::string>(value).size() : 0; }
+
+		// what the node reads from outside, -1 if it changes anything (input, files, variables from themselves)
+		// a WHILE whose condition and body are >= 0 only polls and gets a PollBackoff
+		enum { POLL_INPUT = 1, POLL_TIME = 2, POLL_FILES = 4 };
+		static int pollReads(AstNode* node, bool assigned = false);
+		// WAITUNTIL cond, timeout: false after the timeout, waits on the input changes when cond only reads keys and the cursor
+		variant waitUntil(BinarOpNode* node);
  
 		ErrorHandler error_handler_;
+		OutputSink output_; // stdout of PRINT, the console and the log
+		FileCache files_; // open files of WRITEFILE and APPENDFILE
+		ReadCache reads_; // READFILE and EXISTS with --fs-cache
+		FileTree trees_; // COPYTREE and REMOVETREE, also used by the file jobs
+		std::unique_ptr<FileJobs> file_jobs_; // created by the first ASYNC file operation
+		std::vector<std::unique_ptr<LineSource>> readers_; // OPENREAD/LISTDIR handle n is readers_[n - 1], nullptr after CLOSE
+		std::vector<int> free_readers_; // handles closed by CLOSE
+		std::unordered_map<int, std::shared_ptr<ProcessResult>> exec_results_; // by the handle of ASYNC EXEC
+		int exit_code_; // of the last EXEC, read with EXITCODE
 		std::vector<Variable> variables_;
-		std::unique_ptr<BlockNode> root_;
+		std::shared_ptr<BlockNode> root_; // a Program keeps its tree alive through it
 		std::vector<Symbol> symbols_; // for semantic-analysis-console
+		std::unique_ptr<InputDispatcher> input_dispatcher_; // created by the first ASYNC
+		EventLoop events_;
+		Profiler profiler_; // --profile
+		PhaseStats phases_; // --stats
 
 		/* PROGRAMM FLAGS */
 		bool break_loop_;
@@ -81,12 +185,37 @@ namespace kmsl
 		bool exit_program_;
 		bool is_printable_; // for console, for example: '> a' or '> 4 * 4' # it will print the answer without "print"
 		bool has_errors_;
+		bool async_input_; // inside ASYNC
+		bool in_handler_; // inside the event loop, WAIT just sleeps there
+
+		/* LIMITS */
+		bool limited_; // any of the limits is set
+		unsigned long long max_steps_;
+		double timeout_;
+		std::chrono::steady_clock::time_point deadline_; // max() without --timeout
+		size_t max_memory_;
+		unsigned long long steps_; // statements run
+		size_t string_bytes_; // held by the string variables, only counted with --max-memory
+
+		/* POLLING */
+		bool strict_poll_;
+		std::chrono::microseconds poll_latency_; // the longest sleep of a polling loop
+		PollBackoff::Stats poll_stats_;
+		struct { unsigned long long waits = 0, wakeups = 0, timeouts = 0; } waituntil_stats_;
 
 		/* FLAGS */
 		bool logging_enabled_;
 		bool console_running_;
+		bool stats_enabled_;
+		bool stats_json_;
+		bool streaming_; // runStream
 
 		unsigned short deepness_;
 		variant temp_var_; // workaround: fix the error with the reference to VAR-FUNC (like YEAR, RANDOM etc.)
+		std::mt19937 random_; // RANDOM, per interpreter, std::rand shares its state between threads
+
+		/* STATS */
+		size_t stream_statements_; // statements and lines read by runStream
+		size_t stream_lines_;
 	};
 }
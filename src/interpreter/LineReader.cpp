@@ -0,0 +1,91 @@
+#include "LineReader.hpp"
+
+namespace kmsl
+{
+	namespace
+	{
+		const size_t line_buffer_size = 1 << 16;
+	}
+
+	LineReader::~LineReader()
+	{
+		close();
+	}
+
+	bool LineReader::open(const std::string& path)
+	{
+		close();
+
+		file_ = std::fopen(path.c_str(), "rb");
+		if (!file_)
+			return false;
+
+		buffer_.resize(line_buffer_size);
+		return true;
+	}
+
+	void LineReader::close()
+	{
+		if (file_)
+			std::fclose(file_);
+
+		file_ = nullptr;
+		begin_ = end_ = 0;
+		std::vector<char>().swap(buffer_); // an exhausted reader keeps no memory
+	}
+
+	bool LineReader::readLine(std::string& line)
+	{
+		line.clear();
+
+		if (eof())
+			return false;
+
+		while (true)
+		{
+			const char* data = buffer_.data() + begin_;
+			const char* newline = static_cast<const char*>(std::memchr(data, '\n', end_ - begin_));
+
+			if (newline)
+			{
+				line.append(data, newline - data);
+				begin_ += newline - data + 1;
+				break;
+			}
+
+			// the line goes on in the next block
+			line.append(data, end_ - begin_);
+			begin_ = end_;
+
+			if (!fill())
+				break;
+		}
+
+		if (!line.empty() && line.back() == '\r')
+			line.pop_back();
+
+		return true;
+	}
+
+	bool LineReader::eof()
+	{
+		return begin_ == end_ && !fill();
+	}
+
+	bool LineReader::fill()
+	{
+		if (!file_)
+			return false;
+
+		begin_ = 0;
+		end_ = std::fread(buffer_.data(), 1, buffer_.size(), file_);
+
+		if (end_ == 0)
+		{
+			close();
+			return false;
+		}
+
+		return true;
+	}
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+
+namespace kmsl
+{
+	// what READLINE and EOF read from: files of OPENREAD, dirs of LISTDIR
+	class LineSource
+	{
+	public:
+		virtual ~LineSource() = default;
+
+		virtual bool readLine(std::string& line) = 0; // false at the end
+		virtual bool eof() = 0;
+	};
+
+	// OPENREAD/READLINE/EOF: reads a file line by line through one fixed buffer,
+	// so the memory stays the same for a 1 KB and a 1 GB file
+	class LineReader : public LineSource
+	{
+	public:
+		LineReader() = default;
+		~LineReader();
+
+		LineReader(const LineReader&) = delete;
+		LineReader& operator=(const LineReader&) = delete;
+
+		bool open(const std::string& path);
+		void close();
+
+		bool readLine(std::string& line) override; // without '\n' and '\r', false at the end of the file
+		bool eof() override; // true when no line is left
+
+	private:
+		bool fill(); // false when nothing more could be read
+
+		std::FILE* file_ = nullptr;
+		std::vector<char> buffer_;
+		size_t begin_ = 0; // unread data is [begin_, end_)
+		size_t end_ = 0;
+	};
+}
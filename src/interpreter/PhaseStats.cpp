@@ -0,0 +1,80 @@
+#include "PhaseStats.hpp"
+
+namespace kmsl
+{
+	void PhaseStats::print(std::ostream& os) const
+	{
+		for (size_t i = 0; i < phases_.size(); i++)
+		{
+			const Totals& t = phases_[i];
+			os << name(i) << ": " << std::fixed << std::setprecision(3) << milliseconds(t.time) << " ms, "
+				<< t.allocations << " allocations (" << t.bytes << " bytes), " << t.nodes << " nodes";
+
+			if (i == static_cast<size_t>(Phase::LEXER))
+			{
+				double seconds = std::chrono::duration<double>(t.time).count();
+				os << ", " << tokens_ << " tokens (" << std::setprecision(0) << (seconds > 0 ? tokens_ / seconds : 0) << " tokens/s)";
+			}
+			os << std::endl;
+		}
+
+		if (!counted())
+			os << "allocations: not counted" << std::endl;
+
+		size_t peak = peakMemory();
+		if (peak > 0)
+			os << "peak memory: " << peak << " KB" << std::endl;
+		else
+			os << "peak memory: unknown" << std::endl;
+
+		os.unsetf(std::ios::floatfield);
+	}
+
+	void PhaseStats::printJson(std::ostream& os) const
+	{
+		double lexer_seconds = std::chrono::duration<double>(phases_[static_cast<size_t>(Phase::LEXER)].time).count();
+
+		os << "{\"phases\": {";
+		for (size_t i = 0; i < phases_.size(); i++)
+		{
+			const Totals& t = phases_[i];
+			os << (i ? ", " : "") << '"' << name(i) << "\": {\"ms\": " << std::fixed << std::setprecision(3) << milliseconds(t.time)
+				<< ", \"allocations\": " << t.allocations << ", \"bytes\": " << t.bytes << ", \"nodes\": " << t.nodes << '}';
+		}
+		os << "}, \"tokens\": " << tokens_ << ", \"tokens_per_s\": " << std::setprecision(0) << (lexer_seconds > 0 ? tokens_ / lexer_seconds : 0)
+			<< ", \"allocations_counted\": " << (counted() ? "true" : "false")
+			<< ", \"peak_rss_kb\": " << peakMemory() << '}' << std::endl;
+
+		os.unsetf(std::ios::floatfield);
+	}
+
+	size_t PhaseStats::peakMemory()
+	{
+#ifdef _WIN32
+		PROCESS_MEMORY_COUNTERS counters;
+		if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+			return counters.PeakWorkingSetSize / 1024;
+		return 0;
+#else
+		struct rusage usage;
+		if (getrusage(RUSAGE_SELF, &usage) != 0)
+			return 0;
+#ifdef __APPLE__
+		return static_cast<size_t>(usage.ru_maxrss) / 1024; // bytes there
+#else
+		return static_cast<size_t>(usage.ru_maxrss);
+#endif
+#endif
+	}
+
+	const char* PhaseStats::name(size_t phase)
+	{
+		static const char* names[] = { "lexer", "parser", "semantic", "execution" };
+		return names[phase];
+	}
+
+	double PhaseStats::milliseconds(std::chrono::steady_clock::duration time)
+	{
+		return std::chrono::duration<double, std::milli>(time).count();
+	}
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <ostream>
+#include <iomanip>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "AllocationCounter.hpp"
+#include "../AST/AstNode.hpp"
+
+namespace kmsl
+{
+	enum class Phase { LEXER, PARSER, SEMANTIC, EXECUTION };
+
+	// --stats: time, allocations and created nodes of the lexer, the parser, the semantic analysis
+	// and the execution, summed over all code (console lines, kmsl - statements, DO)
+	class PhaseStats
+	{
+	public:
+		// measures the phase from its construction to its destruction
+		class Scope
+		{
+		public:
+			Scope(PhaseStats& stats, Phase phase)
+				: stats_(stats), phase_(phase), counting_(stats.counting_), start_(std::chrono::steady_clock::now()),
+				allocations_(AllocationCounter::allocations()), bytes_(AllocationCounter::bytes()), nodes_(AstNode::created()) {}
+			~Scope()
+			{
+				Totals& totals = stats_.phases_[static_cast<size_t>(phase_)];
+				totals.time += std::chrono::steady_clock::now() - start_;
+				totals.allocations += AllocationCounter::allocations() - allocations_;
+				totals.bytes += AllocationCounter::bytes() - bytes_;
+				totals.nodes += AstNode::created() - nodes_;
+			}
+
+			Scope(const Scope&) = delete;
+			Scope& operator=(const Scope&) = delete;
+
+		private:
+			PhaseStats& stats_;
+			Phase phase_;
+			AllocationCounter::Scope counting_; // before the counts are read
+			std::chrono::steady_clock::time_point start_;
+			unsigned long long allocations_;
+			unsigned long long bytes_;
+			unsigned long long nodes_;
+		};
+
+		void addTokens(size_t tokens) { tokens_ += tokens; }
+		void setCounting(bool counting) { counting_ = counting; } // allocations of the phases, on their thread
+
+		void print(std::ostream& os) const;
+		void printJson(std::ostream& os) const;
+
+		static size_t peakMemory(); // peak resident set size in KB, 0 if unknown
+
+	private:
+		struct Totals
+		{
+			std::chrono::steady_clock::duration time{ 0 };
+			unsigned long long allocations = 0;
+			unsigned long long bytes = 0;
+			unsigned long long nodes = 0;
+		};
+
+		static const char* name(size_t phase);
+		static double milliseconds(std::chrono::steady_clock::duration time);
+
+		bool counted() const { return counting_ && AllocationCounter::installed(); }
+
+		std::array<Totals, 4> phases_;
+		unsigned long long tokens_ = 0;
+		bool counting_ = false;
+	};
+}
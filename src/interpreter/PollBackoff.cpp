@@ -0,0 +1,45 @@
+#include "PollBackoff.hpp"
+
+namespace kmsl
+{
+	PollBackoff::PollBackoff(Stats& stats, clock::duration bound, bool input_only)
+		: stats_(stats), bound_(bound), input_only_(input_only), start_(clock::now()), sleep_(first_sleep_), seen_(InputState::version())
+	{
+		stats_.loops++;
+	}
+
+	void PollBackoff::idle()
+	{
+		clock::time_point now = clock::now();
+		clock::duration polling = now - start_;
+
+		if (polling < spin_) // the loop itself is the spin, a change right after the start is seen at once
+			return;
+
+		if (polling < yield_)
+		{
+			Scheduler::yield();
+			return;
+		}
+
+		clock::time_point until = now + sleep_;
+		if (input_only_) // only a key or the cursor can end the loop
+		{
+			Scheduler::waitChange(seen_, until);
+			seen_ = InputState::version();
+		}
+		else
+			Scheduler::sleepUntil(until);
+
+		stats_.sleeps++;
+		stats_.slept += clock::now() - now;
+		sleep_ = std::min<clock::duration>(sleep_ * 2, bound_);
+	}
+
+	void PollBackoff::Stats::print(std::ostream& os) const
+	{
+		os << "busy-wait backoff: " << loops << " polling loops, " << sleeps << " sleeps, "
+			<< std::fixed << std::setprecision(1) << std::chrono::duration<double, std::milli>(slept).count() << " ms of spinning saved" << std::endl;
+		os.unsetf(std::ios::floatfield);
+	}
+}
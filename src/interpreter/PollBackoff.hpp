@@ -0,0 +1,48 @@
+#pragma once
+
+#include <chrono>
+#include <thread>
+#include <ostream>
+#include <iomanip>
+#include <algorithm>
+#include <cstdint>
+
+#include "../io/InputState.hpp"
+#include "Scheduler.hpp"
+
+namespace kmsl
+{
+	// slows down a WHILE loop which only polls (WHILE !STATE 'F8' { }, WHILE !EXISTS 'lock' { }):
+	// a short spin, then yields, then sleeps which double up to the latency bound
+	// loops over key and cursor state sleep on the input changes, so a key press still ends them at once
+	class PollBackoff
+	{
+	public:
+		using clock = std::chrono::steady_clock;
+
+		struct Stats
+		{
+			unsigned long long loops = 0;
+			unsigned long long sleeps = 0;
+			std::chrono::nanoseconds slept{ 0 }; // the time the loops would have kept a core busy
+
+			void print(std::ostream& os) const;
+		};
+
+		PollBackoff(Stats& stats, clock::duration bound, bool input_only);
+
+		void idle(); // after an iteration of the loop
+
+	private:
+		static constexpr std::chrono::microseconds spin_{ 50 };
+		static constexpr std::chrono::microseconds yield_{ 1000 };
+		static constexpr std::chrono::microseconds first_sleep_{ 50 };
+
+		Stats& stats_;
+		clock::duration bound_;
+		bool input_only_;
+		clock::time_point start_;
+		clock::duration sleep_;
+		uint64_t seen_; // input version before the reads of the iteration
+	};
+}
@@ -0,0 +1,293 @@
+#include "Profiler.hpp"
+
+namespace kmsl
+{
+	Profiler::Profiler() : enabled_(false)
+	{
+		paths_.push_back(PathNode{ 0, 0 });
+		codes_.push_back(makeCode("", 1));
+	}
+
+	void Profiler::setCode(const std::string& code, int first_line)
+	{
+		codes_.clear();
+		codes_.push_back(makeCode(code, first_line));
+	}
+
+	void Profiler::pushCode(const std::string& code)
+	{
+		Code c = makeCode(code, 1);
+		c.fixed_line = frames_.empty() ? codes_.back().first_line : entries_[frames_.back().entry].line;
+		codes_.push_back(std::move(c));
+	}
+
+	void Profiler::popCode()
+	{
+		if (codes_.size() > 1)
+			codes_.pop_back();
+	}
+
+	void Profiler::enter(AstNode* node)
+	{
+		size_t entry = entryOf(node);
+		size_t parent_path = frames_.empty() ? 0 : frames_.back().path;
+
+		// the call tree only grows where the script goes, so a linear search over the children is enough
+		size_t path = 0;
+		for (size_t child : paths_[parent_path].children)
+			if (paths_[child].entry == entry)
+			{
+				path = child;
+				break;
+			}
+
+		if (path == 0)
+		{
+			path = paths_.size();
+			paths_.push_back(PathNode{ entry, parent_path });
+			paths_[parent_path].children.push_back(path);
+		}
+
+		bool owns_line = frames_.empty() || entries_[frames_.back().entry].line != entries_[entry].line;
+		entries_[entry].active++;
+		frames_.push_back(Frame{ entry, path, owns_line, std::chrono::steady_clock::now() });
+	}
+
+	void Profiler::exit()
+	{
+		Frame frame = frames_.back();
+		frames_.pop_back();
+
+		auto inclusive = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - frame.start);
+		auto exclusive = inclusive - frame.children;
+
+		Entry& entry = entries_[frame.entry];
+		entry.count++;
+		entry.exclusive += exclusive;
+		paths_[frame.path].exclusive += exclusive;
+
+		LineStats& line = lines_[entry.line];
+		line.exclusive += exclusive;
+
+		// recursion through the same line (a FOR and its condition) is counted once
+		if (frame.owns_line)
+		{
+			line.count++;
+			line.inclusive += inclusive;
+		}
+
+		// an entry on the stack twice (DO in a loop) would count its time twice
+		if (--entry.active == 0)
+			entry.inclusive += inclusive;
+
+		if (!frames_.empty())
+			frames_.back().children += inclusive;
+	}
+
+	void Profiler::count(AstNode* node)
+	{
+		entries_[entryOf(node)].count++;
+	}
+
+	size_t Profiler::entryOf(AstNode* node)
+	{
+		Code& code = codes_.back();
+		const Token* token = tokenOf(node);
+		long long pos = token ? token->pos : 0;
+		unsigned long long key = (static_cast<unsigned long long>(pos) << 10) ^ (token ? static_cast<unsigned long long>(token->type) : 0);
+
+		auto it = code.entries.find(key);
+		if (it != code.entries.end())
+			return it->second;
+
+		int line = code.fixed_line ? code.fixed_line : lineOf(pos);
+		std::string label = labelOf(node);
+
+		auto id = entry_ids_.find({ line, label });
+		size_t entry;
+		if (id != entry_ids_.end())
+			entry = id->second;
+		else
+		{
+			entry = entries_.size();
+			entries_.push_back(Entry{ label, line });
+			entry_ids_[{ line, label }] = entry;
+		}
+
+		if (lines_.size() <= static_cast<size_t>(line))
+			lines_.resize(line + 1);
+		if (lines_[line].source.empty())
+			lines_[line].source = sourceLine(line);
+
+		code.entries[key] = entry;
+		return entry;
+	}
+
+	int Profiler::line(AstNode* node) const
+	{
+		if (codes_.empty())
+			return 0;
+
+		const Token* token = tokenOf(node);
+		return codes_.back().fixed_line ? codes_.back().fixed_line : lineOf(token ? token->pos : 0);
+	}
+
+	int Profiler::lineOf(long long pos) const
+	{
+		const Code& code = codes_.back();
+		long long last = pos > 0 ? pos - 1 : 0; // the last character of the token
+
+		auto it = std::upper_bound(code.line_starts.begin(), code.line_starts.end(), static_cast<size_t>(last));
+		size_t index = it == code.line_starts.begin() ? 0 : static_cast<size_t>(it - code.line_starts.begin()) - 1;
+		return code.first_line + static_cast<int>(index);
+	}
+
+	std::string Profiler::sourceLine(int line) const
+	{
+		const Code& code = codes_.front(); // DO lines come from the script
+		long long index = line - code.first_line;
+		if (index < 0 || index >= static_cast<long long>(code.line_starts.size()))
+			return "";
+
+		size_t begin = code.line_starts[index] - index; // without the spaces of the lexer
+		size_t end = code.text.find('\n', begin);
+		std::string source = code.text.substr(begin, end == std::string::npos ? std::string::npos : end - begin);
+
+		size_t first = source.find_first_not_of(" \t");
+		source = first == std::string::npos ? "" : source.substr(first);
+		if (source.size() > 40)
+			source = source.substr(0, 37) + "...";
+		return source;
+	}
+
+	const Token* Profiler::tokenOf(AstNode* node)
+	{
+		// the most frequent nodes first
+		if (auto n = dynamic_cast<BinarOpNode*>(node))
+			return &n->op;
+		if (auto n = dynamic_cast<VariableNode*>(node))
+			return &n->token;
+		if (auto n = dynamic_cast<LiteralNode*>(node))
+			return &n->token;
+		if (auto n = dynamic_cast<UnarOpNode*>(node))
+			return &n->op;
+		if (auto n = dynamic_cast<IfNode*>(node))
+			return &n->token;
+		if (auto n = dynamic_cast<ForNode*>(node))
+			return &n->token;
+		if (auto n = dynamic_cast<WhileNode*>(node))
+			return &n->token;
+		if (auto n = dynamic_cast<MouseNode*>(node))
+			return &n->token;
+		if (auto n = dynamic_cast<KeyNode*>(node))
+			return &n->token;
+		if (auto n = dynamic_cast<CommandNode*>(node))
+			return &n->type;
+		if (auto n = dynamic_cast<AsyncNode*>(node))
+			return &n->token;
+		if (auto n = dynamic_cast<TriggerNode*>(node))
+			return &n->token;
+		if (auto n = dynamic_cast<ExecNode*>(node))
+			return &n->token;
+		return nullptr;
+	}
+
+	std::string Profiler::labelOf(AstNode* node)
+	{
+		std::string label;
+		if (dynamic_cast<LiteralNode*>(node))
+			label = "LITERAL";
+		else if (dynamic_cast<IfNode*>(node)) // their token is the one after the keyword
+			label = "IF";
+		else if (dynamic_cast<ForNode*>(node))
+			label = "FOR";
+		else if (dynamic_cast<WhileNode*>(node))
+			label = "WHILE";
+		else if (auto n = dynamic_cast<VariableNode*>(node))
+			label = n->token.text;
+		else if (const Token* token = tokenOf(node))
+		{
+			label = token->text;
+			for (char& c : label)
+				c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+		}
+		else
+			label = "NODE";
+
+		// ';' and spaces separate the frames and the value in the folded stacks
+		for (char& c : label)
+			if (c == ';' || std::isspace(static_cast<unsigned char>(c)))
+				c = '_';
+		return label;
+	}
+
+	Profiler::Code Profiler::makeCode(const std::string& code, int first_line)
+	{
+		Code c;
+		c.text = code;
+		c.first_line = first_line;
+		c.line_starts.push_back(0);
+
+		for (size_t i = 0; i < code.size(); i++)
+			if (code[i] == '\n')
+				c.line_starts.push_back(i + 1 + c.line_starts.size()); // + the spaces before
+
+		return c;
+	}
+
+	void Profiler::writeFolded(std::ostream& os, const std::string& root) const
+	{
+		std::vector<std::string> names(paths_.size());
+		names[0] = root;
+
+		// parents are always created before their children
+		for (size_t i = 1; i < paths_.size(); i++)
+		{
+			const Entry& entry = entries_[paths_[i].entry];
+			names[i] = names[paths_[i].parent] + ';' + entry.label + ':' + std::to_string(entry.line);
+
+			auto us = std::chrono::duration_cast<std::chrono::microseconds>(paths_[i].exclusive).count();
+			if (us > 0)
+				os << names[i] << ' ' << us << '\n';
+		}
+	}
+
+	void Profiler::printTop(std::ostream& os, size_t n) const
+	{
+		std::vector<int> lines;
+		for (size_t i = 0; i < lines_.size(); i++)
+			if (lines_[i].count > 0 || lines_[i].exclusive.count() > 0)
+				lines.push_back(static_cast<int>(i));
+
+		std::sort(lines.begin(), lines.end(), [&](int a, int b) { return lines_[a].exclusive > lines_[b].exclusive; });
+		if (lines.size() > n)
+			lines.resize(n);
+
+		os << "PROFILE (hot lines):" << std::endl;
+		os << std::setw(6) << "line" << std::setw(12) << "count" << std::setw(12) << "inclusive" << std::setw(12) << "exclusive" << "  source" << std::endl;
+		for (int line : lines)
+			os << std::setw(6) << line << std::setw(12) << lines_[line].count << std::setw(12) << formatTime(lines_[line].inclusive)
+				<< std::setw(12) << formatTime(lines_[line].exclusive) << "  " << lines_[line].source << std::endl;
+
+		std::vector<size_t> entries(entries_.size());
+		for (size_t i = 0; i < entries.size(); i++)
+			entries[i] = i;
+
+		std::sort(entries.begin(), entries.end(), [&](size_t a, size_t b) { return entries_[a].exclusive > entries_[b].exclusive; });
+		if (entries.size() > n)
+			entries.resize(n);
+
+		os << "PROFILE (hot nodes):" << std::endl;
+		os << std::setw(6) << "line" << std::setw(12) << "count" << std::setw(12) << "inclusive" << std::setw(12) << "exclusive" << "  node" << std::endl;
+		for (size_t i : entries)
+			os << std::setw(6) << entries_[i].line << std::setw(12) << entries_[i].count << std::setw(12) << formatTime(entries_[i].inclusive)
+				<< std::setw(12) << formatTime(entries_[i].exclusive) << "  " << entries_[i].label << std::endl;
+	}
+
+	std::string Profiler::formatTime(std::chrono::nanoseconds time)
+	{
+		std::ostringstream ss;
+		ss << std::fixed << std::setprecision(3) << std::chrono::duration<double, std::milli>(time).count() << "ms";
+		return ss.str();
+	}
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <map>
+#include <chrono>
+#include <ostream>
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <cctype>
+
+#include "../AST/ast.hpp"
+
+namespace kmsl
+{
+	// --profile: counts every visited node and measures its inclusive and exclusive time,
+	// per node (statement kind on a line), per source line and per call path for flamegraphs
+	class Profiler
+	{
+	public:
+		// one visit of a node, the guard closes it on every return of visitNode
+		// literals and variables are only counted, two clock reads would cost more than they do
+		class Scope
+		{
+		public:
+			Scope(Profiler& profiler, AstNode* node) : profiler_(nullptr)
+			{
+				if (!profiler.enabled_ || dynamic_cast<BlockNode*>(node))
+					return;
+
+				if (dynamic_cast<LiteralNode*>(node) || dynamic_cast<VariableNode*>(node))
+					profiler.count(node);
+				else
+				{
+					profiler_ = &profiler;
+					profiler_->enter(node);
+				}
+			}
+			~Scope()
+			{
+				if (profiler_)
+					profiler_->exit();
+			}
+
+			Scope(const Scope&) = delete;
+			Scope& operator=(const Scope&) = delete;
+
+		private:
+			Profiler* profiler_;
+		};
+
+		Profiler();
+
+		void setEnabled(bool enabled) { enabled_ = enabled; }
+		bool enabled() const { return enabled_; }
+
+		// the code whose token positions are mapped to lines, first_line for kmsl -
+		void setCode(const std::string& code, int first_line = 1);
+		void pushCode(const std::string& code); // DO, its nodes are counted on the line of the DO
+		void popCode();
+
+		// "kmsl;FOR:3;WAIT:5 1200", microseconds of exclusive time; --multi puts the file name as the root
+		void writeFolded(std::ostream& os, const std::string& root = "kmsl") const;
+
+		// for --trace, without counting the node
+		static std::string label(AstNode* node) { return labelOf(node); }
+		int line(AstNode* node) const;
+		void printTop(std::ostream& os, size_t n) const; // the hottest lines and nodes
+
+	private:
+		struct Entry // a node kind on a line
+		{
+			std::string label;
+			int line;
+			unsigned long long count = 0;
+			std::chrono::nanoseconds inclusive{ 0 };
+			std::chrono::nanoseconds exclusive{ 0 };
+			unsigned int active = 0; // frames on the stack
+		};
+
+		struct LineStats
+		{
+			std::string source;
+			unsigned long long count = 0; // visits entered from another line
+			std::chrono::nanoseconds inclusive{ 0 };
+			std::chrono::nanoseconds exclusive{ 0 };
+		};
+
+		struct PathNode // call tree for the folded stacks
+		{
+			PathNode(size_t entry, size_t parent) : entry(entry), parent(parent) {}
+
+			size_t entry;
+			size_t parent;
+			std::vector<size_t> children;
+			std::chrono::nanoseconds exclusive{ 0 };
+		};
+
+		struct Frame
+		{
+			size_t entry;
+			size_t path;
+			bool owns_line; // the parent is on another line, so the time counts for the line
+			std::chrono::steady_clock::time_point start;
+			std::chrono::nanoseconds children{ 0 };
+		};
+
+		struct Code
+		{
+			std::string text;
+			std::vector<size_t> line_starts; // positions of the lexer, which adds a space after every '\n'
+			int first_line;
+			int fixed_line = 0; // DO: all of its nodes are on the line of the DO
+			std::unordered_map<unsigned long long, size_t> entries; // by token position and type, clones share them
+		};
+
+		void enter(AstNode* node);
+		void exit();
+		void count(AstNode* node); // without time
+
+		size_t entryOf(AstNode* node);
+		int lineOf(long long pos) const; // pos is the end of the token, like Token.pos
+		std::string sourceLine(int line) const;
+		static const Token* tokenOf(AstNode* node);
+		static std::string labelOf(AstNode* node);
+		static Code makeCode(const std::string& code, int first_line);
+		static std::string formatTime(std::chrono::nanoseconds time);
+
+		bool enabled_;
+		std::vector<Code> codes_; // the script and the DO code running in it
+		std::vector<Entry> entries_;
+		std::map<std::pair<int, std::string>, size_t> entry_ids_;
+		std::vector<LineStats> lines_; // by line
+		std::vector<PathNode> paths_; // paths_[0] is the root
+		std::vector<Frame> frames_;
+	};
+}
@@ -0,0 +1,30 @@
+#include "Program.hpp"
+
+namespace kmsl
+{
+	std::shared_ptr<const Program> Program::compile(const std::string& code)
+	{
+		auto program = std::make_shared<Program>();
+		program->code_ = code + " ";
+
+		ErrorHandler error_handler;
+		error_handler.setCode(FileReader::replaceEscapedNewlines(program->code_));
+
+		std::vector<Token> tokens = Lexer(program->code_).scanTokens();
+		Parser parser(tokens, error_handler);
+		program->root_ = parser.parse();
+
+		if (error_handler.getErrorsCount() == 0)
+		{
+			SemanticAnalyzer semantic(program->root_, error_handler);
+			semantic.analyze();
+		}
+
+		if (error_handler.getErrorsCount() > 0)
+		{
+			error_handler.showErrors();
+			return nullptr;
+		}
+		return program;
+	}
+}
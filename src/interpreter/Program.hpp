@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+
+#include "../AST/ast.hpp"
+#include "../lexer/Lexer.hpp"
+#include "../parser/Parser.hpp"
+#include "../semantic/SemanticAnalyzer.hpp"
+#include "../error/ErrorHandler.hpp"
+#include "FileReader.hpp"
+
+namespace kmsl
+{
+	// a script which was lexed, parsed and checked once
+	// the interpreters only read the tree, so one Program can run in any number of them at the same time, also on other threads
+	class Program
+	{
+	public:
+		// nullptr after a syntax or semantic error, the errors are shown like for kmsl <file>
+		static std::shared_ptr<const Program> compile(const std::string& code);
+
+		const std::string& code() const { return code_; }
+		BlockNode* root() const { return root_.get(); }
+
+	private:
+		std::string code_; // with the trailing space of Interpreter::setCode
+		std::unique_ptr<BlockNode> root_;
+	};
+}
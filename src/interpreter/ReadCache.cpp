@@ -0,0 +1,231 @@
+#include "ReadCache.hpp"
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+namespace kmsl
+{
+	ReadCache::~ReadCache()
+	{
+#ifdef __linux__
+		if (inotify_fd_ != -1)
+			::close(inotify_fd_);
+#endif
+	}
+
+	void ReadCache::setEnabled(bool enabled)
+	{
+		enabled_ = enabled;
+#ifdef __linux__
+		if (enabled && inotify_fd_ == -1)
+			inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC); // -1: falls back to mtime and size
+#endif
+	}
+
+	bool ReadCache::exists(const std::string& path)
+	{
+		if (!enabled_)
+			return std::filesystem::exists(path);
+
+		std::string k = key(path);
+		Entry* entry = find(k, false);
+		if (!entry)
+			entry = &load(k, path, false);
+
+		return entry->exists;
+	}
+
+	bool ReadCache::read(const std::string& path, std::string& text)
+	{
+		if (!enabled_)
+		{
+			if (!std::filesystem::exists(path))
+				return false;
+
+			text = FileReader(path).read();
+			return true;
+		}
+
+		std::string k = key(path);
+		Entry* entry = find(k, true);
+		if (!entry)
+			entry = &load(k, path, true);
+
+		if (!entry->exists)
+			return false;
+
+		text = entry->text;
+		return true;
+	}
+
+	void ReadCache::invalidate(const std::string& path)
+	{
+		if (enabled_ && !entries_.empty())
+			entries_.erase(key(path));
+	}
+
+	void ReadCache::printStats(std::ostream& os) const
+	{
+		if (!enabled_)
+		{
+			os << "read cache: not used" << std::endl;
+			return;
+		}
+
+		os << "read cache: " << hits_ << " hits, " << misses_ << " misses";
+#ifdef __linux__
+		if (inotify_fd_ != -1)
+			os << " (" << watches_.size() << " dirs watched)";
+#endif
+		os << std::endl;
+	}
+
+	ReadCache::Entry* ReadCache::find(const std::string& key, bool with_text)
+	{
+#ifdef __linux__
+		drainEvents();
+#endif
+		auto it = entries_.find(key);
+		if (it == entries_.end())
+			return nullptr;
+
+		Entry& entry = it->second;
+		if (with_text && entry.exists && !entry.has_text)
+			return nullptr; // only EXISTS was asked before
+
+		if (!entry.watched)
+		{
+			Entry now;
+			stat(key, now);
+			if (now.exists != entry.exists || (now.exists && (now.mtime != entry.mtime || now.size != entry.size)))
+				return nullptr;
+		}
+
+		hits_++;
+		return &entry;
+	}
+
+	ReadCache::Entry& ReadCache::load(const std::string& key, const std::string& path, bool with_text)
+	{
+		misses_++;
+
+		Entry& entry = entries_[key];
+		entry = Entry();
+
+#ifdef __linux__
+		entry.watched = watch(parent(key)); // before the file is read, so no change is missed
+#endif
+		stat(path, entry);
+
+		if (entry.exists && with_text)
+		{
+			entry.text = FileReader(path).read();
+			entry.has_text = true;
+		}
+
+		return entry;
+	}
+
+	void ReadCache::stat(const std::string& path, Entry& entry)
+	{
+		std::error_code ec;
+		entry.exists = std::filesystem::exists(path, ec);
+		if (!entry.exists)
+			return;
+
+		entry.mtime = std::filesystem::last_write_time(path, ec);
+		entry.size = std::filesystem::is_regular_file(path, ec) ? std::filesystem::file_size(path, ec) : 0;
+	}
+
+	std::string ReadCache::key(const std::string& path)
+	{
+		return std::filesystem::path(path).lexically_normal().generic_string();
+	}
+
+	std::string ReadCache::parent(const std::string& key)
+	{
+		std::string dir = std::filesystem::path(key).parent_path().generic_string();
+		return dir.empty() ? "." : dir;
+	}
+
+#ifdef __linux__
+	bool ReadCache::watch(const std::string& dir)
+	{
+		if (inotify_fd_ == -1)
+			return false;
+
+		if (watches_.count(dir))
+			return true;
+
+		int wd = inotify_add_watch(inotify_fd_, dir.c_str(),
+			IN_CREATE | IN_DELETE | IN_MODIFY | IN_ATTRIB | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF);
+		if (wd == -1)
+			return false; // the dir does not exist, mtime and size are checked instead
+
+		dirs_[wd] = dir;
+		watches_[dir] = wd;
+		return true;
+	}
+
+	void ReadCache::drainEvents()
+	{
+		if (inotify_fd_ == -1 || watches_.empty())
+			return;
+
+		alignas(inotify_event) char buffer[4096];
+
+		while (true)
+		{
+			ssize_t n = ::read(inotify_fd_, buffer, sizeof(buffer));
+			if (n <= 0)
+				break; // EAGAIN, nothing has changed
+
+			for (char* p = buffer; p < buffer + n; )
+			{
+				auto event = reinterpret_cast<inotify_event*>(p);
+				p += sizeof(inotify_event) + event->len;
+
+				if (event->mask & IN_Q_OVERFLOW)
+				{
+					entries_.clear();
+					continue;
+				}
+
+				auto it = dirs_.find(event->wd);
+				if (it == dirs_.end())
+					continue;
+
+				std::string dir = it->second;
+				if (event->mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF))
+				{
+					dropDir(dir);
+					if (event->mask & IN_IGNORED)
+					{
+						dirs_.erase(event->wd);
+						watches_.erase(dir);
+					}
+				}
+				else if (event->len > 0)
+				{
+					std::string name(event->name);
+					entries_.erase(dir == "." ? name : dir.back() == '/' ? dir + name : dir + '/' + name);
+				}
+			}
+		}
+	}
+
+	void ReadCache::dropDir(const std::string& dir)
+	{
+		for (auto it = entries_.begin(); it != entries_.end(); )
+		{
+			if (it->second.watched && parent(it->first) == dir)
+				it = entries_.erase(it);
+			else
+				++it;
+		}
+	}
+#endif
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <filesystem>
+#include <system_error>
+#include <ostream>
+
+#include "FileReader.hpp"
+
+namespace kmsl
+{
+	// results of READFILE and EXISTS by path (kmsl --fs-cache), for scripts which poll a flag file in a loop
+	// on linux the directories are watched with inotify, so a hit costs no syscall on the path;
+	// elsewhere an entry is checked against the mtime and size of the file
+	// the script's own writes invalidate the entries of the written paths
+	class ReadCache
+	{
+	public:
+		~ReadCache();
+
+		void setEnabled(bool enabled); // the inotify fd is only created for a cache which is used
+
+		bool exists(const std::string& path);
+		bool read(const std::string& path, std::string& text); // false if the file does not exist
+
+		void invalidate(const std::string& path); // after WRITEFILE, REMOVE, RENAME etc.
+
+		void printStats(std::ostream& os) const;
+
+	private:
+		struct Entry
+		{
+			bool exists = false;
+			bool has_text = false;
+			std::string text;
+			std::filesystem::file_time_type mtime;
+			std::uintmax_t size = 0;
+			bool watched = false; // valid until inotify says otherwise
+		};
+
+		Entry* find(const std::string& key, bool with_text); // a valid entry or nullptr
+		Entry& load(const std::string& key, const std::string& path, bool with_text);
+		static void stat(const std::string& path, Entry& entry);
+		static std::string key(const std::string& path);
+		static std::string parent(const std::string& key);
+
+		bool enabled_ = false;
+		std::unordered_map<std::string, Entry> entries_;
+
+#ifdef __linux__
+		bool watch(const std::string& dir);
+		void drainEvents(); // drops the entries of all changed files
+		void dropDir(const std::string& dir);
+
+		int inotify_fd_ = -1;
+		std::unordered_map<int, std::string> dirs_; // watch descriptor -> dir
+		std::unordered_map<std::string, int> watches_;
+#endif
+
+		/* STATS */
+		unsigned long long hits_ = 0;
+		unsigned long long misses_ = 0;
+	};
+}
@@ -0,0 +1,264 @@
+#include "Scheduler.hpp"
+
+#include <thread>
+#include <iostream>
+#include <iomanip>
+#include <stdexcept>
+
+namespace kmsl
+{
+	thread_local Scheduler* Scheduler::running_(nullptr);
+
+	Scheduler::Scheduler(size_t stack_size) : stack_size_(stack_size) {}
+
+	Scheduler::~Scheduler()
+	{
+		for (const auto& task : tasks_)
+			freeStack(*task);
+	}
+
+	void Scheduler::spawn(const std::string& name, std::function<void()> body)
+	{
+		auto task = std::make_unique<Task>();
+		task->name = name;
+		task->body = std::move(body);
+
+#ifdef _WIN32
+		task->fiber = CreateFiberEx(0, stack_size_, FIBER_FLAG_FLOAT_SWITCH, fiberEntry, nullptr);
+		if (!task->fiber)
+			throw std::runtime_error("can not create a fiber for " + name);
+#else
+		size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+		void* memory = mmap(nullptr, page + stack_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+		if (memory == MAP_FAILED)
+			throw std::runtime_error("can not map a stack for " + name);
+		task->stack = static_cast<char*>(memory);
+		mprotect(task->stack, page, PROT_NONE); // the stack grows down into the guard page
+
+		getcontext(&task->context);
+		task->context.uc_stack.ss_sp = task->stack + page;
+		task->context.uc_stack.ss_size = stack_size_;
+		task->context.uc_link = nullptr; // entry() switches back itself
+		makecontext(&task->context, entry, 0);
+#endif
+
+		ready_.push_back(task.get());
+		tasks_.push_back(std::move(task));
+		alive_++;
+	}
+
+	void Scheduler::run()
+	{
+		running_ = this;
+#ifdef _WIN32
+		main_fiber_ = ConvertThreadToFiber(nullptr);
+#endif
+
+		while (alive_ > 0)
+		{
+			while (!ready_.empty())
+			{
+				Task* task = ready_.front();
+				ready_.pop_front();
+				resume(*task);
+			}
+
+			if (alive_ == 0)
+				break;
+
+			uint64_t version = InputState::version(); // read before checking, so no event gets lost
+			clock::time_point now = clock::now();
+
+			while (!timers_.empty() && timers_.top().at <= now)
+			{
+				Timer timer = timers_.top();
+				timers_.pop();
+				if (timer.task->state == Task::State::WAITING && timer.task->timer == timer.generation)
+				{
+					wake(*timer.task);
+					timer_wakeups_++;
+				}
+			}
+
+			if (input_waiters_ > 0)
+			{
+				for (const auto& task : tasks_)
+				{
+					if (task->state == Task::State::WAITING && task->on_input && task->seen != version)
+					{
+						wake(*task);
+						input_wakeups_++;
+					}
+				}
+			}
+
+			if (!ready_.empty())
+				continue;
+
+			clock::time_point next = timers_.empty() ? clock::time_point::max() : timers_.top().at;
+			if (input_waiters_ > 0)
+				InputState::waitChange(version, next);
+			else
+				std::this_thread::sleep_until(next);
+			idle_ += clock::now() - now;
+		}
+
+#ifdef _WIN32
+		ConvertFiberToThread();
+		main_fiber_ = nullptr;
+#endif
+		running_ = nullptr;
+	}
+
+	void Scheduler::sleepUntil(clock::time_point until)
+	{
+		if (active())
+			running_->wait(until, false, 0);
+		else
+			std::this_thread::sleep_until(until);
+	}
+
+	void Scheduler::waitChange(uint64_t seen, clock::time_point until)
+	{
+		if (active())
+			running_->wait(until, true, seen);
+		else
+			InputState::waitChange(seen, until);
+	}
+
+	void Scheduler::yield()
+	{
+		if (!active())
+		{
+			std::this_thread::yield();
+			return;
+		}
+
+		Task& task = *running_->current_;
+		running_->ready_.push_back(&task);
+		running_->suspend(task);
+	}
+
+	void Scheduler::waitFor(const std::function<bool()>& ready)
+	{
+		if (!active())
+			return;
+
+		clock::duration pause = first_pause_;
+		while (!ready())
+		{
+			sleepUntil(clock::now() + pause);
+			pause = std::min<clock::duration>(pause * 2, max_pause_);
+		}
+	}
+
+	void Scheduler::printStats(std::ostream& os) const
+	{
+		os << "scheduler: " << tasks_.size() << " scripts on one thread, " << switches_ << " switches, "
+			<< timer_wakeups_ << " timer and " << input_wakeups_ << " input wakeups, "
+			<< std::fixed << std::setprecision(1) << std::chrono::duration<double, std::milli>(idle_).count() << " ms idle, "
+			<< stack_size_ / 1024 << " KB stack per script" << std::endl;
+		os.unsetf(std::ios::floatfield);
+	}
+
+	void Scheduler::resume(Task& task)
+	{
+		current_ = &task;
+		switches_++;
+#ifdef _WIN32
+		SwitchToFiber(task.fiber);
+#else
+		swapcontext(&main_context_, &task.context);
+#endif
+		current_ = nullptr;
+
+		if (task.state == Task::State::ENDED)
+		{
+			freeStack(task);
+			task.body = nullptr; // the interpreter of the script
+			alive_--;
+		}
+	}
+
+	void Scheduler::suspend(Task& task)
+	{
+#ifdef _WIN32
+		(void)task;
+		SwitchToFiber(main_fiber_);
+#else
+		swapcontext(&task.context, &main_context_);
+#endif
+	}
+
+	void Scheduler::wake(Task& task)
+	{
+		if (task.on_input)
+			input_waiters_--;
+
+		task.state = Task::State::READY;
+		task.on_input = false;
+		task.timer++; // the timer of the wait is stale now
+		ready_.push_back(&task);
+	}
+
+	void Scheduler::wait(clock::time_point until, bool on_input, uint64_t seen)
+	{
+		Task& task = *current_;
+
+		if (on_input && InputState::version() != seen)
+			return;
+		if (!on_input && until <= clock::now())
+		{
+			yield(); // WAIT 0 still lets the others run
+			return;
+		}
+
+		task.state = Task::State::WAITING;
+		task.on_input = on_input;
+		task.seen = seen;
+		if (on_input)
+			input_waiters_++;
+		if (until != clock::time_point::max())
+			timers_.push({ until, &task, task.timer });
+
+		suspend(task);
+	}
+
+	void Scheduler::freeStack(Task& task)
+	{
+#ifdef _WIN32
+		if (task.fiber)
+			DeleteFiber(task.fiber);
+		task.fiber = nullptr;
+#else
+		if (task.stack)
+			munmap(task.stack, static_cast<size_t>(sysconf(_SC_PAGESIZE)) + stack_size_);
+		task.stack = nullptr;
+#endif
+	}
+
+#ifdef _WIN32
+	VOID CALLBACK Scheduler::fiberEntry(LPVOID)
+	{
+		entry();
+	}
+#endif
+
+	void Scheduler::entry()
+	{
+		Scheduler* scheduler = running_;
+		Task& task = *scheduler->current_;
+
+		try
+		{
+			task.body();
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << "Error: " << task.name << ": " << e.what() << std::endl;
+		}
+
+		task.state = Task::State::ENDED;
+		scheduler->suspend(task); // never comes back, run() frees the stack
+	}
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <queue>
+#include <deque>
+#include <functional>
+#include <chrono>
+#include <ostream>
+#include <cstdint>
+
+#include "../io/InputState.hpp"
+
+#ifndef _WIN32
+#include <ucontext.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace kmsl
+{
+	// kmsl --multi: runs many scripts on one thread, every script is a task with its own stack (a fiber)
+	// WAIT, WAITKEY, WAITUNTIL, ON KEY/EVERY, timed input, EXEC and AWAIT suspend the task instead of the thread,
+	// the scheduler sleeps until the next timer of its heap or the next input event when no task is ready
+	class Scheduler
+	{
+	public:
+		using clock = std::chrono::steady_clock;
+
+		explicit Scheduler(size_t stack_size = default_stack_);
+		~Scheduler();
+
+		void spawn(const std::string& name, std::function<void()> body);
+		void run(); // until every task has ended
+
+		// inside a task they let the other tasks run, outside of --multi they block the thread as before
+		static bool active() { return running_ && running_->current_; }
+		static void sleepUntil(clock::time_point until);
+		static void waitChange(uint64_t seen, clock::time_point until); // like InputState::waitChange
+		static void yield();
+		// work of another thread (EXEC, ASYNC file jobs), checked with growing pauses until ready() is true
+		// outside of a task it returns at once and the caller blocks on its own
+		static void waitFor(const std::function<bool()>& ready);
+
+		void printStats(std::ostream& os) const;
+
+	private:
+		// as big as the stack of a thread: DO lexes and parses in the task, std::regex recurses deeply
+		// it is only reserved, the touched pages cost memory, a guard page below it stops an overflow
+		static constexpr size_t default_stack_ = 8 * 1024 * 1024;
+		static constexpr std::chrono::microseconds first_pause_{ 100 };
+		static constexpr std::chrono::milliseconds max_pause_{ 10 };
+
+		struct Task
+		{
+			enum class State { READY, WAITING, ENDED };
+
+			std::string name;
+			std::function<void()> body;
+			State state = State::READY;
+			bool on_input = false; // waits until InputState::version() != seen
+			uint64_t seen = 0;
+			uint32_t timer = 0; // generation, a task woken by input leaves a stale timer in the heap
+#ifdef _WIN32
+			LPVOID fiber = nullptr;
+#else
+			ucontext_t context;
+			char* stack = nullptr; // mapping of the guard page and the stack
+#endif
+		};
+
+		struct Timer
+		{
+			clock::time_point at;
+			Task* task;
+			uint32_t generation;
+
+			bool operator>(const Timer& other) const { return at > other.at; }
+		};
+
+		void resume(Task& task);
+		void suspend(Task& task); // back to run()
+		void wake(Task& task);
+		void wait(clock::time_point until, bool on_input, uint64_t seen);
+		void freeStack(Task& task);
+
+#ifdef _WIN32
+		static VOID CALLBACK fiberEntry(LPVOID);
+#endif
+		static void entry();
+
+		static thread_local Scheduler* running_;
+
+		size_t stack_size_;
+		std::vector<std::unique_ptr<Task>> tasks_;
+		std::deque<Task*> ready_;
+		std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers_;
+		size_t alive_ = 0;
+		size_t input_waiters_ = 0;
+		Task* current_ = nullptr;
+#ifdef _WIN32
+		LPVOID main_fiber_ = nullptr;
+#else
+		ucontext_t main_context_;
+#endif
+
+		/* STATS */
+		unsigned long long switches_ = 0;
+		unsigned long long timer_wakeups_ = 0;
+		unsigned long long input_wakeups_ = 0;
+		clock::duration idle_ = clock::duration::zero(); // the thread slept, no task was ready
+	};
+}
@@ -0,0 +1,160 @@
+#include "StatementReader.hpp"
+
+namespace kmsl
+{
+	bool StatementReader::next(std::string& statement)
+	{
+		statement.clear();
+
+		std::string line;
+		while (readLine(line))
+		{
+			if (statement.empty())
+			{
+				if (isBlank(line))
+					continue;
+				begin(line);
+			}
+
+			statement += line + '\n';
+			scan(line);
+
+			if (!complete())
+				continue;
+
+			// ELSE can only be on the line right after the IF block
+			if (is_if_ && !has_else_ && readLine(line))
+			{
+				if (isKeyword(firstWord(line), "ELSE"))
+				{
+					statement += line + '\n';
+					scan(line);
+					if (!complete())
+						continue;
+				}
+				else
+				{
+					held_ = line;
+					has_held_ = true;
+					line_number_--; // counted again when it is taken
+				}
+			}
+
+			statements_++;
+			return true;
+		}
+
+		// an unfinished construct at the end goes to the parser, which reports it
+		if (statement.empty())
+			return false;
+
+		statements_++;
+		return true;
+	}
+
+	bool StatementReader::readLine(std::string& line)
+	{
+		if (has_held_)
+		{
+			line = std::move(held_);
+			has_held_ = false;
+		}
+		else if (!std::getline(in_, line))
+			return false;
+
+		if (!line.empty() && line.back() == '\r')
+			line.pop_back();
+
+		line_number_++;
+		return true;
+	}
+
+	void StatementReader::begin(const std::string& line)
+	{
+		first_line_ = line_number_;
+		depth_ = 0;
+		quote_ = 0;
+		has_else_ = false;
+
+		std::string word = firstWord(line);
+		is_if_ = isKeyword(word, "IF");
+		needs_block_ = is_if_ || isKeyword(word, "WHILE") || isKeyword(word, "FOR") || isKeyword(word, "ON") || isKeyword(word, "EVERY");
+	}
+
+	void StatementReader::scan(const std::string& line)
+	{
+		for (size_t i = 0; i < line.size(); i++)
+		{
+			char c = line[i];
+
+			if (quote_)
+			{
+				if (c == quote_)
+					quote_ = 0;
+			}
+			else if (c == '"' || c == '\'')
+				quote_ = c;
+			else if (c == '#')
+				break;
+			else if (c == '{')
+			{
+				if (depth_ == 0)
+					needs_block_ = false;
+				depth_++;
+			}
+			else if (c == '(')
+				depth_++;
+			else if (c == '}' || c == ')')
+				depth_--;
+			else if (std::isalpha(static_cast<unsigned char>(c)) || c == '_')
+			{
+				size_t end = i;
+				while (end < line.size() && (std::isalnum(static_cast<unsigned char>(line[end])) || line[end] == '_'))
+					end++;
+
+				std::string word = line.substr(i, end - i);
+				if (depth_ == 0 && isKeyword(word, "ELSE")) // } ELSE {
+				{
+					needs_block_ = true;
+					has_else_ = true;
+				}
+				i = end - 1;
+			}
+		}
+	}
+
+	bool StatementReader::complete() const
+	{
+		return depth_ <= 0 && !needs_block_ && !quote_;
+	}
+
+	std::string StatementReader::firstWord(const std::string& line)
+	{
+		size_t begin = line.find_first_not_of(" \t");
+		if (begin == std::string::npos)
+			return "";
+
+		size_t end = begin;
+		while (end < line.size() && (std::isalnum(static_cast<unsigned char>(line[end])) || line[end] == '_'))
+			end++;
+
+		return line.substr(begin, end - begin);
+	}
+
+	bool StatementReader::isKeyword(const std::string& word, const std::string& keyword)
+	{
+		if (word == keyword)
+			return true;
+
+		std::string lower = keyword;
+		for (char& c : lower)
+			c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+		return word == lower;
+	}
+
+	bool StatementReader::isBlank(const std::string& line)
+	{
+		size_t begin = line.find_first_not_of(" \t");
+		return begin == std::string::npos || line[begin] == '#';
+	}
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <string>
+#include <istream>
+#include <cctype>
+
+namespace kmsl
+{
+	// kmsl -: cuts a script stream into top-level statements as the lines arrive,
+	// only an unfinished IF, FOR, WHILE, ON, EVERY or '(' is kept until its end comes
+	class StatementReader
+	{
+	public:
+		explicit StatementReader(std::istream& in) : in_(in) {}
+
+		bool next(std::string& statement); // false at the end of the stream
+		size_t line() const { return first_line_; } // where the last statement starts, from 1
+
+		size_t statements() const { return statements_; }
+		size_t lines() const { return line_number_; }
+
+	private:
+		bool readLine(std::string& line); // the held line first
+		void begin(const std::string& line); // the first line of a statement
+		void scan(const std::string& line); // braces, parentheses, strings and ELSE
+		bool complete() const;
+
+		static std::string firstWord(const std::string& line);
+		static bool isKeyword(const std::string& word, const std::string& keyword); // IF or if
+		static bool isBlank(const std::string& line); // empty or only a comment
+
+		std::istream& in_;
+		std::string held_; // the line after an IF block, read to look for ELSE
+		bool has_held_ = false;
+		size_t line_number_ = 0; // lines read
+		size_t first_line_ = 0;
+		size_t statements_ = 0;
+
+		int depth_ = 0; // open '(' and '{'
+		char quote_ = 0; // strings may go over several lines
+		bool needs_block_ = false; // IF, WHILE etc. before their '{'
+		bool is_if_ = false;
+		bool has_else_ = false;
+	};
+}
@@ -0,0 +1,72 @@
+#include "TimerWheel.hpp"
+
+namespace kmsl
+{
+	TimerWheel::TimerWheel(clock::duration tick, size_t slots)
+		: slots_(slots), tick_(tick), start_(clock::now()), current_tick_(0), count_(0) {}
+
+	void TimerWheel::schedule(uint64_t id, clock::time_point deadline)
+	{
+		uint64_t tick = std::max(toTick(deadline), current_tick_ + 1); // a passed deadline expires with the next tick
+		uint64_t rounds = (tick - current_tick_ - 1) / slots_.size();
+
+		slots_[tick % slots_.size()].push_back({ id, rounds });
+		count_++;
+	}
+
+	std::vector<uint64_t> TimerWheel::advance(clock::time_point now)
+	{
+		std::vector<uint64_t> expired;
+		uint64_t target = now <= start_ ? 0 : static_cast<uint64_t>((now - start_) / tick_); // only the completed ticks
+
+		// every tick touches one slot, with no timers there is nothing to catch up
+		if (count_ == 0)
+			current_tick_ = std::max(current_tick_, target);
+
+		while (current_tick_ < target)
+		{
+			current_tick_++;
+			std::vector<Timer>& slot = slots_[current_tick_ % slots_.size()];
+
+			for (size_t i = 0; i < slot.size();)
+			{
+				if (slot[i].rounds == 0)
+				{
+					expired.push_back(slot[i].id);
+					slot[i] = slot.back();
+					slot.pop_back();
+					count_--;
+				}
+				else
+					slot[i++].rounds--;
+			}
+		}
+
+		return expired;
+	}
+
+	TimerWheel::clock::time_point TimerWheel::nextExpiry() const
+	{
+		if (count_ == 0)
+			return clock::time_point::max();
+
+		for (uint64_t tick = current_tick_ + 1; tick <= current_tick_ + slots_.size(); tick++)
+			for (const Timer& timer : slots_[tick % slots_.size()])
+				if (timer.rounds == 0)
+					return toTime(tick);
+
+		return toTime(current_tick_ + slots_.size()); // nothing in this revolution
+	}
+
+	uint64_t TimerWheel::toTick(clock::time_point time) const
+	{
+		if (time <= start_)
+			return 0;
+		return static_cast<uint64_t>((time - start_ + tick_ - clock::duration(1)) / tick_); // rounded up, timers never fire early
+	}
+
+	TimerWheel::clock::time_point TimerWheel::toTime(uint64_t tick) const
+	{
+		return start_ + tick_ * tick;
+	}
+}
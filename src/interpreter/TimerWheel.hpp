@@ -0,0 +1,40 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+
+namespace kmsl
+{
+	// hashed timer wheel: scheduling and expiring are O(1) per timer,
+	// timers further away than one revolution wait for their rounds in the same slot
+	class TimerWheel
+	{
+	public:
+		using clock = std::chrono::steady_clock;
+
+		TimerWheel(clock::duration tick = std::chrono::milliseconds(1), size_t slots = 512);
+
+		void schedule(uint64_t id, clock::time_point deadline);
+		std::vector<uint64_t> advance(clock::time_point now); // ids of the expired timers
+		clock::time_point nextExpiry() const; // the caller can sleep until then
+		bool empty() const { return count_ == 0; }
+
+	private:
+		struct Timer
+		{
+			uint64_t id;
+			uint64_t rounds; // revolutions left before it expires
+		};
+
+		uint64_t toTick(clock::time_point time) const;
+		clock::time_point toTime(uint64_t tick) const;
+
+		std::vector<std::vector<Timer>> slots_;
+		clock::duration tick_;
+		clock::time_point start_;
+		uint64_t current_tick_; // last processed tick
+		size_t count_;
+	};
+}
@@ -0,0 +1,124 @@
+#include "InputDispatcher.hpp"
+
+namespace kmsl
+{
+	InputDispatcher::InputDispatcher() : running_(true), sleeping_(false), queued_(0), dispatched_(0),
+		max_depth_(0), latency_us_(0), started_(std::chrono::steady_clock::now())
+	{
+		worker_ = std::thread(&InputDispatcher::run, this);
+	}
+
+	InputDispatcher::~InputDispatcher()
+	{
+		sync();
+
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			running_ = false;
+		}
+		wake_.notify_one();
+		worker_.join();
+	}
+
+	void InputDispatcher::push(InputEvent event)
+	{
+		event.timestamp = std::chrono::steady_clock::now();
+		queued_++;
+
+		while (!queue_.push(std::move(event))) // ring is full, the dispatcher is far behind
+			std::this_thread::yield();
+
+		size_t depth = queue_.size();
+		size_t max_depth = max_depth_.load(std::memory_order_relaxed);
+		while (depth > max_depth && !max_depth_.compare_exchange_weak(max_depth, depth, std::memory_order_relaxed));
+
+		// pairs with the fence in run(): either the worker sees the event or we see that it sleeps
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (sleeping_.load(std::memory_order_relaxed))
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			wake_.notify_one();
+		}
+	}
+
+	void InputDispatcher::sync()
+	{
+		if (dispatched_.load() == queued_.load())
+			return;
+
+		std::unique_lock<std::mutex> lock(mutex_);
+		drained_.wait(lock, [&] { return dispatched_.load() == queued_.load(); });
+	}
+
+	void InputDispatcher::run()
+	{
+		Trace::setThreadName("input dispatcher");
+
+		while (true)
+		{
+			InputEvent event;
+			if (queue_.pop(event))
+			{
+				auto waited = std::chrono::steady_clock::now() - event.timestamp;
+				latency_us_ += std::chrono::duration_cast<std::chrono::microseconds>(waited).count();
+
+				execute(event);
+
+				if (++dispatched_ == queued_.load())
+				{
+					std::lock_guard<std::mutex> lock(mutex_);
+					drained_.notify_all();
+				}
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(mutex_);
+			sleeping_.store(true, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			wake_.wait(lock, [&] { return !queue_.empty() || !running_; });
+			sleeping_.store(false, std::memory_order_relaxed);
+
+			if (!running_ && queue_.empty())
+				break;
+		}
+	}
+
+	void InputDispatcher::execute(const InputEvent& event)
+	{
+		switch (event.type)
+		{
+		case InputEventType::MOVE:
+			IoController::moveTo(event.x, event.y, event.time);
+			break;
+		case InputEventType::DMOVE:
+			IoController::moveBy(event.x, event.y, event.time);
+			break;
+		case InputEventType::SCROLL:
+			IoController::scroll(event.x, event.time);
+			break;
+		case InputEventType::TYPE:
+			IoController::type(event.text, event.time);
+			break;
+		case InputEventType::PRESS:
+			IoController::press(event.buttons, event.time);
+			break;
+		case InputEventType::REPLAY:
+			InputReplayer::replay(event.text, event.time);
+			break;
+		}
+	}
+
+	void InputDispatcher::printStats(std::ostream& os) const
+	{
+		unsigned long long dispatched = dispatched_.load();
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started_).count();
+
+		os << "input dispatcher: " << queued_.load() << " queued, " << dispatched << " dispatched, "
+			<< "queue depth " << depth() << " (max " << max_depth_.load() << "), ";
+
+		if (dispatched > 0)
+			os << "avg queue latency " << (latency_us_.load() / static_cast<double>(dispatched)) / 1000.0 << " ms, ";
+
+		os << "throughput " << (seconds > 0 ? dispatched / seconds : 0.0) << " events/s" << std::endl;
+	}
+}
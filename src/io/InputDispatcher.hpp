@@ -0,0 +1,70 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <ostream>
+
+#include "SpscQueue.hpp"
+#include "IoController.hpp"
+#include "InputLog.hpp"
+#include "Trace.hpp"
+
+namespace kmsl
+{
+	enum class InputEventType
+	{
+		MOVE, DMOVE, SCROLL, TYPE, PRESS, REPLAY,
+	};
+
+	struct InputEvent
+	{
+		InputEventType type = InputEventType::MOVE;
+		int x = 0; // MOVE/DMOVE x, SCROLL amount
+		int y = 0;
+		float time = 0.f; // REPLAY speed
+		std::string text; // TYPE, REPLAY file
+		std::vector<std::string> buttons; // PRESS
+		std::chrono::steady_clock::time_point timestamp; // when the interpreter queued it
+	};
+
+	// runs input events on its own thread, so ASYNC MOVE, PRESS etc. do not block the interpreter
+	// the interpreter is the only producer and the dispatcher thread the only consumer
+	class InputDispatcher
+	{
+	public:
+		InputDispatcher();
+		~InputDispatcher();
+
+		void push(InputEvent event);
+		void sync(); // blocks until every queued event was executed
+
+		size_t depth() const { return queue_.size(); }
+		void printStats(std::ostream& os) const;
+
+		static void execute(const InputEvent& event);
+
+	private:
+		void run();
+
+		SpscQueue<InputEvent, 1024> queue_;
+		std::thread worker_;
+		std::atomic<bool> running_;
+		std::atomic<bool> sleeping_;
+
+		std::mutex mutex_;
+		std::condition_variable wake_; // queue got an event
+		std::condition_variable drained_; // every queued event was executed
+
+		/* STATS */
+		std::atomic<unsigned long long> queued_;
+		std::atomic<unsigned long long> dispatched_;
+		std::atomic<size_t> max_depth_;
+		std::atomic<long long> latency_us_; // sum of the time events waited in the queue
+		std::chrono::steady_clock::time_point started_;
+	};
+}
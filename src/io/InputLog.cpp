@@ -0,0 +1,206 @@
+#include "InputLog.hpp"
+#include "IoController.hpp"
+#include "../interpreter/Scheduler.hpp"
+
+namespace kmsl
+{
+	namespace
+	{
+		const char magic[] = { 'K', 'M', 'R', 'E', 'C', 1 };
+		const size_t file_buffer_size = 1 << 16;
+
+		bool getVarint(std::istream& in, uint64_t& value)
+		{
+			value = 0;
+			for (int shift = 0; shift < 64; shift += 7)
+			{
+				int c = in.get();
+				if (c == EOF)
+					return false;
+
+				value |= static_cast<uint64_t>(c & 0x7F) << shift;
+				if (!(c & 0x80))
+					return true;
+			}
+			return false;
+		}
+
+		bool getZigzag(std::istream& in, int64_t& value)
+		{
+			uint64_t raw;
+			if (!getVarint(in, raw))
+				return false;
+
+			value = static_cast<int64_t>(raw >> 1) ^ -static_cast<int64_t>(raw & 1);
+			return true;
+		}
+	}
+
+	InputRecorder::InputRecorder(const std::string& path)
+		: buffer_(file_buffer_size), last_(std::chrono::steady_clock::now()), last_x_(0), last_y_(0), events_(0), bytes_(0)
+	{
+		file_.rdbuf()->pubsetbuf(buffer_.data(), buffer_.size()); // before open, otherwise it is ignored
+		file_.open(path, std::ios::binary | std::ios::trunc);
+
+		if (file_.is_open())
+		{
+			file_.write(magic, sizeof(magic));
+			bytes_ = sizeof(magic);
+		}
+	}
+
+	InputRecorder::~InputRecorder()
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (file_.is_open())
+			file_.close();
+	}
+
+	void InputRecorder::key(WORD keyCode, bool down)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		begin(down ? InputLogKind::KEY_DOWN : InputLogKind::KEY_UP);
+		record_.push_back(static_cast<char>(keyCode & 0xFF));
+		write();
+	}
+
+	void InputRecorder::move(int x, int y)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		begin(InputLogKind::MOVE);
+		putZigzag(static_cast<int64_t>(x) - last_x_);
+		putZigzag(static_cast<int64_t>(y) - last_y_);
+		last_x_ = x;
+		last_y_ = y;
+		write();
+	}
+
+	void InputRecorder::scroll(int amount)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		begin(InputLogKind::SCROLL);
+		putZigzag(amount);
+		write();
+	}
+
+	void InputRecorder::begin(InputLogKind kind)
+	{
+		auto now = std::chrono::steady_clock::now();
+		uint64_t delta = std::chrono::duration_cast<std::chrono::microseconds>(now - last_).count();
+		last_ = now;
+
+		record_.clear();
+		putVarint((delta << 2) | static_cast<uint64_t>(kind));
+	}
+
+	void InputRecorder::putVarint(uint64_t value)
+	{
+		while (value >= 0x80)
+		{
+			record_.push_back(static_cast<char>((value & 0x7F) | 0x80));
+			value >>= 7;
+		}
+		record_.push_back(static_cast<char>(value));
+	}
+
+	void InputRecorder::putZigzag(int64_t value)
+	{
+		putVarint((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+	}
+
+	void InputRecorder::write()
+	{
+		if (!file_.is_open())
+			return;
+
+		file_.write(record_.data(), record_.size());
+		bytes_ += record_.size();
+		events_++;
+	}
+
+	bool InputReplayer::isLog(const std::string& path)
+	{
+		std::ifstream file(path, std::ios::binary);
+		char header[sizeof(magic)];
+
+		return file.read(header, sizeof(header)) && std::equal(header, header + sizeof(header), magic);
+	}
+
+	void InputReplayer::replay(const std::string& path, double speed)
+	{
+		std::vector<char> buffer(file_buffer_size);
+		std::ifstream file;
+		file.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+		file.open(path, std::ios::binary);
+
+		char header[sizeof(magic)];
+		if (!file.read(header, sizeof(header)) || !std::equal(header, header + sizeof(header), magic))
+			return;
+
+		auto start = std::chrono::steady_clock::now();
+		uint64_t elapsed = 0; // recorded microseconds
+		int x = 0, y = 0;
+
+		// a truncated last record (e.g. the recorder was killed) just ends the replay
+		uint64_t head;
+		while (getVarint(file, head))
+		{
+			elapsed += head >> 2;
+			InputLogKind kind = static_cast<InputLogKind>(head & 3);
+
+			int64_t dx = 0, dy = 0, amount = 0;
+			int keyCode = 0;
+
+			switch (kind)
+			{
+			case InputLogKind::KEY_DOWN:
+			case InputLogKind::KEY_UP:
+				if ((keyCode = file.get()) == EOF)
+					return;
+				break;
+			case InputLogKind::MOVE:
+				if (!getZigzag(file, dx) || !getZigzag(file, dy))
+					return;
+				break;
+			case InputLogKind::SCROLL:
+				if (!getZigzag(file, amount))
+					return;
+				break;
+			}
+
+			waitUntil(start + std::chrono::microseconds(static_cast<long long>(elapsed / speed)));
+
+			switch (kind)
+			{
+			case InputLogKind::KEY_DOWN:
+			case InputLogKind::KEY_UP:
+				IoController::sendKeys({ static_cast<WORD>(keyCode) }, kind == InputLogKind::KEY_DOWN);
+				break;
+			case InputLogKind::MOVE:
+				x += static_cast<int>(dx);
+				y += static_cast<int>(dy);
+				IoController::setCursor(x, y);
+				break;
+			case InputLogKind::SCROLL:
+				IoController::sendScroll(static_cast<int>(amount));
+				break;
+			}
+		}
+	}
+
+	void InputReplayer::waitUntil(std::chrono::steady_clock::time_point deadline)
+	{
+		IoController::sendPending(); // REPLAY may run inside a batch of the interpreter
+
+		// sleeping is only as exact as the scheduler tick (about 15 ms on windows), the rest is spun
+		// under --multi both let the other scripts run
+		const auto spin = std::chrono::milliseconds(2);
+
+		auto now = std::chrono::steady_clock::now();
+		if (deadline - now > spin)
+			Scheduler::sleepUntil(deadline - spin);
+
+		while (std::chrono::steady_clock::now() < deadline)
+			Scheduler::yield();
+	}
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <mutex>
+#include <chrono>
+#include <thread>
+#include <cstdint>
+#include <algorithm>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include "VirtualKeys.hpp"
+#endif
+
+namespace kmsl
+{
+	// .kmrec format: "KMREC" and a version byte, then one record per event
+	// record: varint(microseconds since the previous event << 2 | kind) and the payload
+	//   KEY_DOWN, KEY_UP: key code (1 byte)
+	//   MOVE: zigzag varint dx, dy to the previous position
+	//   SCROLL: zigzag varint amount
+	enum class InputLogKind : uint8_t
+	{
+		KEY_DOWN, KEY_UP, MOVE, SCROLL,
+	};
+
+	// writes the events of InputState into a .kmrec file (kmsl --record)
+	class InputRecorder
+	{
+	public:
+		explicit InputRecorder(const std::string& path);
+		~InputRecorder();
+
+		bool isOpen() const { return file_.is_open(); }
+		unsigned long long events() const { return events_; }
+		unsigned long long bytes() const { return bytes_; }
+
+		// called by the event sources, possibly from several threads
+		void key(WORD keyCode, bool down);
+		void move(int x, int y);
+		void scroll(int amount);
+
+	private:
+		// encodes the record header into record_
+		void begin(InputLogKind kind);
+		void putVarint(uint64_t value);
+		void putZigzag(int64_t value);
+		void write();
+
+		std::mutex mutex_;
+		std::vector<char> buffer_; // big file buffer, events are tiny
+		std::ofstream file_;
+		std::vector<char> record_;
+		std::chrono::steady_clock::time_point last_;
+		int last_x_;
+		int last_y_;
+		unsigned long long events_;
+		unsigned long long bytes_;
+	};
+
+	// plays a .kmrec file back through IoController (REPLAY)
+	class InputReplayer
+	{
+	public:
+		static bool isLog(const std::string& path);
+
+		// reads the file in chunks, so the memory does not grow with the length of the log
+		// speed 2 plays twice as fast, every event has its own deadline, so the delay does not add up
+		static void replay(const std::string& path, double speed);
+
+	private:
+		static void waitUntil(std::chrono::steady_clock::time_point deadline);
+	};
+}
@@ -0,0 +1,241 @@
+#include "InputState.hpp"
+#include "InputLog.hpp"
+
+namespace kmsl
+{
+	std::array<std::atomic<uint64_t>, 4> InputState::keys_;
+	std::array<std::atomic<uint32_t>, 256> InputState::presses_;
+	std::atomic<uint64_t> InputState::version_(0);
+	std::atomic<uint64_t> InputState::cursor_(0);
+	std::atomic<bool> InputState::started_(false);
+	std::atomic<int> InputState::waiters_(0);
+	std::mutex InputState::mutex_;
+	std::condition_variable InputState::changed_;
+	InputRecorder* InputState::recorder_(nullptr);
+	std::atomic<bool> InputState::recording_(false);
+	std::mutex InputState::recorder_mutex_;
+
+#if defined(_WIN32) && !defined(KMSL_NULL_IO) // kmsl_bench has no hooks
+	namespace
+	{
+		void updateModifier(WORD generic, WORD left, WORD right)
+		{
+			InputState::onKey(generic, InputState::isKeyDown(left) || InputState::isKeyDown(right));
+		}
+
+		LRESULT CALLBACK keyboardProc(int nCode, WPARAM wParam, LPARAM lParam)
+		{
+			if (nCode == HC_ACTION)
+			{
+				auto info = reinterpret_cast<KBDLLHOOKSTRUCT*>(lParam);
+				WORD keyCode = static_cast<WORD>(info->vkCode);
+				InputState::onKey(keyCode, wParam == WM_KEYDOWN || wParam == WM_SYSKEYDOWN);
+
+				// GetAsyncKeyState(VK_SHIFT) is TRUE for both shifts, the hook only reports the sided codes
+				switch (keyCode)
+				{
+				case VK_LSHIFT: case VK_RSHIFT: updateModifier(VK_SHIFT, VK_LSHIFT, VK_RSHIFT); break;
+				case VK_LCONTROL: case VK_RCONTROL: updateModifier(VK_CONTROL, VK_LCONTROL, VK_RCONTROL); break;
+				case VK_LMENU: case VK_RMENU: updateModifier(VK_MENU, VK_LMENU, VK_RMENU); break;
+				}
+			}
+			return CallNextHookEx(NULL, nCode, wParam, lParam);
+		}
+
+		LRESULT CALLBACK mouseProc(int nCode, WPARAM wParam, LPARAM lParam)
+		{
+			if (nCode == HC_ACTION)
+			{
+				auto info = reinterpret_cast<MSLLHOOKSTRUCT*>(lParam);
+				switch (wParam)
+				{
+				case WM_MOUSEMOVE: InputState::onMove(info->pt.x, info->pt.y); break;
+				case WM_MOUSEWHEEL: InputState::onScroll(static_cast<short>(HIWORD(info->mouseData))); break;
+				case WM_LBUTTONDOWN: InputState::onKey(VK_LBUTTON, true); break;
+				case WM_LBUTTONUP: InputState::onKey(VK_LBUTTON, false); break;
+				case WM_RBUTTONDOWN: InputState::onKey(VK_RBUTTON, true); break;
+				case WM_RBUTTONUP: InputState::onKey(VK_RBUTTON, false); break;
+				case WM_MBUTTONDOWN: InputState::onKey(VK_MBUTTON, true); break;
+				case WM_MBUTTONUP: InputState::onKey(VK_MBUTTON, false); break;
+				case WM_XBUTTONDOWN:
+				case WM_XBUTTONUP:
+					InputState::onKey(HIWORD(info->mouseData) == XBUTTON1 ? VK_XBUTTON1 : VK_XBUTTON2, wParam == WM_XBUTTONDOWN);
+					break;
+				}
+			}
+			return CallNextHookEx(NULL, nCode, wParam, lParam);
+		}
+
+		void hookThread(std::promise<void>* ready)
+		{
+			HHOOK keyboardHook = SetWindowsHookEx(WH_KEYBOARD_LL, keyboardProc, GetModuleHandle(NULL), 0);
+			HHOOK mouseHook = SetWindowsHookEx(WH_MOUSE_LL, mouseProc, GetModuleHandle(NULL), 0);
+
+			// the hooks only report changes, so the current state is read once
+			for (int keyCode = 0x01; keyCode <= 0xFE; keyCode++)
+				if (GetAsyncKeyState(keyCode) & 0x8000)
+					InputState::onKey(static_cast<WORD>(keyCode), true);
+
+			POINT p;
+			if (GetCursorPos(&p))
+				InputState::onMove(p.x, p.y);
+
+			ready->set_value();
+
+			MSG msg; // low-level hooks are called through the message loop of the thread which set them
+			while (GetMessage(&msg, NULL, 0, 0) > 0)
+			{
+				TranslateMessage(&msg);
+				DispatchMessage(&msg);
+			}
+
+			UnhookWindowsHookEx(keyboardHook);
+			UnhookWindowsHookEx(mouseHook);
+		}
+	}
+#endif
+
+	void InputState::start()
+	{
+		if (started_.load(std::memory_order_acquire))
+			return;
+
+		static std::mutex start_mutex; // not mutex_, the hook thread may notify while we wait for it
+		std::lock_guard<std::mutex> lock(start_mutex);
+		if (started_.load(std::memory_order_relaxed))
+			return;
+
+#if defined(_WIN32) && !defined(KMSL_NULL_IO)
+		std::promise<void> ready;
+		std::thread(hookThread, &ready).detach(); // lives as long as the process
+		ready.get_future().wait();
+#endif
+		started_.store(true, std::memory_order_release);
+	}
+
+	bool InputState::isKeyDown(WORD keyCode)
+	{
+		keyCode &= 0xFF;
+		return (keys_[keyCode >> 6].load(std::memory_order_acquire) >> (keyCode & 63)) & 1;
+	}
+
+	void InputState::getCursor(int& x, int& y)
+	{
+		uint64_t cursor = cursor_.load(std::memory_order_acquire);
+		x = static_cast<int32_t>(static_cast<uint32_t>(cursor >> 32));
+		y = static_cast<int32_t>(static_cast<uint32_t>(cursor));
+	}
+
+	void InputState::waitKey(WORD keyCode)
+	{
+		start();
+
+		if (isKeyDown(keyCode))
+			return;
+
+		std::unique_lock<std::mutex> lock(mutex_);
+		waiters_++;
+		std::atomic_thread_fence(std::memory_order_seq_cst); // pairs with notify()
+		changed_.wait(lock, [&] { return isKeyDown(keyCode); });
+		waiters_--;
+	}
+
+	uint32_t InputState::pressCount(WORD keyCode)
+	{
+		return presses_[keyCode & 0xFF].load(std::memory_order_acquire);
+	}
+
+	uint64_t InputState::version()
+	{
+		return version_.load(std::memory_order_acquire);
+	}
+
+	void InputState::waitChange(uint64_t seen, std::chrono::steady_clock::time_point deadline)
+	{
+		start();
+
+		std::unique_lock<std::mutex> lock(mutex_);
+		waiters_++;
+		std::atomic_thread_fence(std::memory_order_seq_cst); // pairs with notify()
+
+		auto changed = [&] { return version_.load(std::memory_order_acquire) != seen; };
+		if (deadline == std::chrono::steady_clock::time_point::max())
+			changed_.wait(lock, changed);
+		else
+			changed_.wait_until(lock, deadline, changed);
+
+		waiters_--;
+	}
+
+	void InputState::onKey(WORD keyCode, bool down)
+	{
+		keyCode &= 0xFF;
+		uint64_t bit = uint64_t(1) << (keyCode & 63);
+
+		if (down)
+		{
+			// auto-repeat sends key downs while the key is held, only the first one is a press
+			if (!(keys_[keyCode >> 6].fetch_or(bit, std::memory_order_acq_rel) & bit))
+				presses_[keyCode].fetch_add(1, std::memory_order_acq_rel);
+		}
+		else
+			keys_[keyCode >> 6].fetch_and(~bit, std::memory_order_acq_rel);
+
+		if (recording_.load(std::memory_order_relaxed))
+		{
+			std::lock_guard<std::mutex> lock(recorder_mutex_);
+			if (recorder_)
+				recorder_->key(keyCode, down);
+		}
+
+		notify();
+	}
+
+	void InputState::onMove(int x, int y)
+	{
+		uint64_t cursor = (static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32) | static_cast<uint32_t>(y);
+		cursor_.store(cursor, std::memory_order_release);
+
+		if (recording_.load(std::memory_order_relaxed))
+		{
+			std::lock_guard<std::mutex> lock(recorder_mutex_);
+			if (recorder_)
+				recorder_->move(x, y);
+		}
+
+		notify();
+	}
+
+	void InputState::onScroll(int amount)
+	{
+		if (recording_.load(std::memory_order_relaxed))
+		{
+			std::lock_guard<std::mutex> lock(recorder_mutex_);
+			if (recorder_)
+				recorder_->scroll(amount);
+		}
+	}
+
+	void InputState::setRecorder(InputRecorder* recorder)
+	{
+		if (recorder)
+			start(); // the hooks deliver the real input
+
+		std::lock_guard<std::mutex> lock(recorder_mutex_);
+		recorder_ = recorder;
+		recording_.store(recorder != nullptr, std::memory_order_relaxed);
+	}
+
+	void InputState::notify()
+	{
+		version_.fetch_add(1, std::memory_order_acq_rel);
+
+		// the event sources must stay cheap, the lock is only taken when somebody waits
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (waiters_.load(std::memory_order_relaxed) > 0)
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			changed_.notify_all();
+		}
+	}
+}
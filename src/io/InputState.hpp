@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <array>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <future>
+#include <cstdint>
+#include <chrono>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include "VirtualKeys.hpp"
+#endif
+
+namespace kmsl
+{
+	class InputRecorder;
+
+	// cache of the key states and the cursor position, kept up to date by input events
+	// on windows a hook thread listens to the low-level keyboard/mouse hooks,
+	// in the headless backend the simulated input of IoController is the only source
+	// reading is lock-free, so STATE, GETX and GETY do not cost a syscall anymore
+	class InputState
+	{
+	public:
+		static void start(); // starts the hook thread once, cheap when it already runs
+
+		static bool isKeyDown(WORD keyCode);
+		static void getCursor(int& x, int& y);
+		static void waitKey(WORD keyCode); // blocks until the key is down
+
+		static uint32_t pressCount(WORD keyCode); // how often the key went down
+		static uint64_t version(); // changes with every event
+		static void waitChange(uint64_t seen, std::chrono::steady_clock::time_point deadline); // until version() != seen
+
+		// every event is also written to the recorder (kmsl --record), nullptr stops it
+		static void setRecorder(InputRecorder* recorder);
+
+		// event sources
+		static void onKey(WORD keyCode, bool down);
+		static void onMove(int x, int y);
+		static void onScroll(int amount); // not cached, only recorded
+
+	private:
+		static void notify();
+
+		static std::array<std::atomic<uint64_t>, 4> keys_; // one bit per virtual key code
+		static std::array<std::atomic<uint32_t>, 256> presses_;
+		static std::atomic<uint64_t> version_;
+		static std::atomic<uint64_t> cursor_; // x in the high, y in the low 32 bits
+		static std::atomic<bool> started_;
+		static std::atomic<int> waiters_;
+		static std::mutex mutex_;
+		static std::condition_variable changed_;
+
+		static InputRecorder* recorder_;
+		static std::atomic<bool> recording_; // checked first, so the mutex costs nothing without --record
+		static std::mutex recorder_mutex_;
+	};
+}
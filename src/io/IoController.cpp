@@ -1,21 +1,30 @@
 ﻿#include "IoController.hpp"
+#include "Trace.hpp"
+#include "Metrics.hpp"
+#include "../interpreter/Scheduler.hpp"
 #include <iostream>
 
 namespace kmsl
 {
+    thread_local IoController::Batch IoController::batch_;
+    std::atomic<unsigned long long> IoController::requested_(0);
+    std::atomic<unsigned long long> IoController::issued_(0);
+
 	void IoController::moveTo(int x, int y, float t)
 	{
-        POINT startPos;
-        GetCursorPos(&startPos);
+        Trace::Span span("io", "move");
+        span.args("\"x\": %d, \"y\": %d, \"t\": %g", x, y, t);
+
+        beginBatch(); // without time only the last of the steps is sent
 
-        int startX = startPos.x;
-        int startY = startPos.y;
+        int startX, startY;
+        getCursor(startX, startY);
 
         int deltaX = x - startX;
-        int deltaY = y - startY; 
+        int deltaY = y - startY;
 
         int steps = 100;
-        float stepTime = t / steps; 
+        float stepTime = t / steps;
 
         for (int i = 0; i <= steps; ++i)
         {
@@ -23,51 +32,54 @@ namespace kmsl
             int currentX = static_cast<int>(startX + deltaX * factor);
             int currentY = static_cast<int>(startY + deltaY * factor);
 
-            SetCursorPos(currentX, currentY);
+            setCursor(currentX, currentY);
 
-            std::this_thread::sleep_for(std::chrono::milliseconds(static_cast<int>(stepTime * 1000)));
+            pause(stepTime);
         }
+
+        endBatch();
 	}
 
     void IoController::moveBy(int dx, int dy, float t)
     {
-        POINT startPos;
-        GetCursorPos(&startPos);
-        moveTo(dx + startPos.x, dy + startPos.y, t);
+        int startX, startY;
+        getCursor(startX, startY);
+        moveTo(dx + startX, dy + startY, t);
     }
 
     void IoController::scroll(int amount, float t) // -amound down, amount up
     {
+        Trace::Span span("io", "scroll");
+        span.args("\"amount\": %d, \"t\": %g", amount, t);
+
+        beginBatch();
+
         int steps = 100;
         float stepTime = std::max(t / steps, 0.01f);
         int scrollAmountPerStep = amount / steps;
 
-        INPUT input;
-        ZeroMemory(&input, sizeof(INPUT));
-        input.type = INPUT_MOUSE;
-        input.mi.dx = 0;
-        input.mi.dy = 0;
-        input.mi.dwFlags = MOUSEEVENTF_WHEEL;
-
         for (int i = 0; i < steps; ++i)
         {
-            input.mi.mouseData = scrollAmountPerStep;
-            SendInput(1, &input, sizeof(INPUT));
-           
+            sendScroll(scrollAmountPerStep);
+
             if (t != 0)
-                std::this_thread::sleep_for(std::chrono::milliseconds(static_cast<int>(stepTime * 1000)));
+                pause(stepTime);
         }
 
         int remainingScroll = amount % steps;
         if (remainingScroll != 0)
-        {
-            input.mi.mouseData = remainingScroll;
-            SendInput(1, &input, sizeof(INPUT));
-        }
+            sendScroll(remainingScroll);
+
+        endBatch();
     }
 
     void IoController::type(const std::string& text, float t)
     {
+        Trace::Span span("io", "type");
+        span.args("\"chars\": %zu, \"t\": %g", text.size(), t);
+
+        beginBatch();
+
         for (char c : text)
         {
             std::string s(1, c);
@@ -75,105 +87,101 @@ namespace kmsl
                 press({ "SHIFT", s }, 0.f);
             else
                 press({ s }, 0.f);
-            std::this_thread::sleep_for(std::chrono::milliseconds(static_cast<int>(t * 1000)));
+            pause(t);
         }
+
+        endBatch();
     }
 
 
     void IoController::press(const std::vector<std::string>& buttons, float t)
     {
+        Trace::Span span("io", "press");
+        span.args("\"keys\": %zu, \"t\": %g", buttons.size(), t);
+
+        beginBatch();
+
         hold(buttons);
 
-        std::this_thread::sleep_for(std::chrono::milliseconds(static_cast<int>(t * 1000)));
+        pause(t);
 
         release(buttons);
+
+        endBatch();
     }
 
     void IoController::hold(const std::vector<std::string>& buttons) {
-        std::vector<INPUT> inputs;
+        Trace::Span span("io", "hold");
+        std::vector<WORD> keyCodes;
 
         for (const auto& button : buttons) {
             WORD keyCode = getVirtualKeyCode(button);
-            if (keyCode == 0) continue;
-
-            if (keyCode >= VK_LBUTTON && keyCode <= VK_XBUTTON2) {
-                DWORD mouseFlags;
-                switch (keyCode) {
-                case VK_LBUTTON: mouseFlags = MOUSEEVENTF_LEFTDOWN; break;
-                case VK_RBUTTON: mouseFlags = MOUSEEVENTF_RIGHTDOWN; break;
-                case VK_MBUTTON: mouseFlags = MOUSEEVENTF_MIDDLEDOWN; break;
-                case VK_XBUTTON1: mouseFlags = MOUSEEVENTF_XDOWN; break;
-                case VK_XBUTTON2: mouseFlags = MOUSEEVENTF_XDOWN; break;
-                default: continue;
-                }
-                inputs.push_back(createMouseInput(keyCode, mouseFlags));
-            }
-            else {
-                inputs.push_back(createKeyboardInput(keyCode, 0));
-            }
+            if (keyCode != 0)
+                keyCodes.push_back(keyCode);
         }
 
-        SendInput(static_cast<UINT>(inputs.size()), inputs.data(), sizeof(INPUT));
+        sendKeys(keyCodes, true);
     }
 
     void IoController::release(const std::vector<std::string>& buttons) {
-        std::vector<INPUT> inputs;
+        Trace::Span span("io", "release");
+        std::vector<WORD> keyCodes;
 
         for (const auto& button : buttons) {
             WORD keyCode = getVirtualKeyCode(button);
-            if (keyCode == 0) continue;
-
-            if (keyCode >= VK_LBUTTON && keyCode <= VK_XBUTTON2) {
-                DWORD mouseFlags;
-                switch (keyCode) {
-                case VK_LBUTTON: mouseFlags = MOUSEEVENTF_LEFTUP; break;
-                case VK_RBUTTON: mouseFlags = MOUSEEVENTF_RIGHTUP; break;
-                case VK_MBUTTON: mouseFlags = MOUSEEVENTF_MIDDLEUP; break;
-                case VK_XBUTTON1: mouseFlags = MOUSEEVENTF_XUP; break;
-                case VK_XBUTTON2: mouseFlags = MOUSEEVENTF_XUP; break;
-                default: continue;
-                }
-                inputs.push_back(createMouseInput(keyCode, mouseFlags));
-            }
-            else {
-                inputs.push_back(createKeyboardInput(keyCode, KEYEVENTF_KEYUP));
-            }
+            if (keyCode != 0)
+                keyCodes.push_back(keyCode);
         }
 
-        SendInput(static_cast<UINT>(inputs.size()), inputs.data(), sizeof(INPUT));
+        sendKeys(keyCodes, false);
     }
 
     bool IoController::getState(const std::string& button)
     {
+        sendPending(); // the state has to include the batched input
+
         WORD keyCode = getVirtualKeyCode(button);
         if (keyCode >= 0x01 && keyCode <= 0xFE)
         {
-            SHORT state = GetAsyncKeyState(keyCode);
-            return (state & 0x8000) != 0;
+            InputState::start();
+            return InputState::isKeyDown(keyCode);
         }
 
-        if (keyCode == VK_LBUTTON || keyCode == VK_RBUTTON || keyCode == VK_MBUTTON || keyCode == VK_XBUTTON1 || keyCode == VK_XBUTTON2)
+        return false;
+    }
+
+    bool IoController::waitKey(const std::string& button)
+    {
+        WORD keyCode = getVirtualKeyCode(button);
+        if (keyCode < 0x01 || keyCode > 0xFE)
+            return false;
+
+        if (!Scheduler::active())
         {
-            SHORT state = GetAsyncKeyState(keyCode);
-            return (state & 0x8000) != 0;
+            InputState::waitKey(keyCode);
+            return true;
         }
 
-        return false;
+        InputState::start(); // --multi: only this script waits for the key
+        while (true)
+        {
+            uint64_t seen = InputState::version();
+            if (InputState::isKeyDown(keyCode))
+                return true;
+            Scheduler::waitChange(seen, std::chrono::steady_clock::time_point::max());
+        }
     }
 
     void IoController::getMouseCoordinates(int& x, int& y)
     {
-        POINT p;
-        if (GetCursorPos(&p))
-        {
-            x = p.x;
-            y = p.y;
-        }
+        sendPending();
+        InputState::start();
+        InputState::getCursor(x, y);
     }
 
     WORD IoController::getVirtualKeyCode(const std::string& key)
     {
-        static std::map<std::string, WORD> keyMap = {
+        static const std::unordered_map<std::string, WORD> keyMap = {
             // alphabet keys
             {"A", 0x41}, {"B", 0x42}, {"C", 0x43}, {"D", 0x44},
             {"E", 0x45}, {"F", 0x46}, {"G", 0x47}, {"H", 0x48},
@@ -226,6 +234,173 @@ namespace kmsl
         return 0;
     }
 
+    void IoController::beginBatch()
+    {
+        batch_.depth++;
+    }
+
+    void IoController::endBatch()
+    {
+        if (--batch_.depth == 0)
+            sendPending();
+    }
+
+    void IoController::sendPending()
+    {
+        if (batch_.pending.empty())
+            return;
+
+        Trace::Span span("io", "send");
+        span.args("\"inputs\": %zu", batch_.pending.size());
+        Metrics::add(Metrics::Counter::INPUT_EVENTS, batch_.pending.size());
+
+        sendInputs(batch_.pending);
+        batch_.pending.clear();
+        issued_++;
+    }
+
+    void IoController::printStats(std::ostream& os)
+    {
+        unsigned long long requested = requested_.load();
+        unsigned long long issued = issued_.load();
+
+        os << "input batching: " << requested << " input calls, " << issued << " syscalls ("
+            << (requested > issued ? requested - issued : 0) << " saved)" << std::endl;
+    }
+
+    void IoController::getCursor(int& x, int& y)
+    {
+        for (auto it = batch_.pending.rbegin(); it != batch_.pending.rend(); ++it)
+        {
+            if (it->kind == PendingInput::Kind::MOVE)
+            {
+                x = it->x;
+                y = it->y;
+                return;
+            }
+        }
+
+        readCursor(x, y);
+    }
+
+    void IoController::setCursor(int x, int y)
+    {
+        requested_++;
+        queue({ PendingInput::Kind::MOVE, 0, false, x, y });
+    }
+
+    void IoController::sendScroll(int amount)
+    {
+        requested_++;
+        queue({ PendingInput::Kind::SCROLL, 0, false, amount, 0 });
+    }
+
+    void IoController::sendKeys(const std::vector<WORD>& keyCodes, bool down)
+    {
+        if (keyCodes.empty())
+            return;
+
+        requested_++;
+
+        beginBatch(); // the keys of one call always go together
+        for (WORD keyCode : keyCodes)
+            queue({ PendingInput::Kind::KEY, keyCode, down, 0, 0 });
+        endBatch();
+    }
+
+    void IoController::queue(const PendingInput& input)
+    {
+        std::vector<PendingInput>& pending = batch_.pending;
+
+        // only the end position of moves in a row matters, scrolls in a row add up
+        if (!pending.empty() && input.kind != PendingInput::Kind::KEY && pending.back().kind == input.kind)
+        {
+            if (input.kind == PendingInput::Kind::MOVE)
+                pending.back() = input;
+            else
+                pending.back().x += input.x;
+        }
+        else
+            pending.push_back(input);
+
+        if (batch_.depth == 0)
+            sendPending();
+    }
+
+    void IoController::pause(float t)
+    {
+        int ms = static_cast<int>(t * 1000);
+        if (ms <= 0)
+            return;
+
+        sendPending();
+
+        Trace::Span span("io", "sleep");
+        span.args("\"ms\": %d", ms);
+        Scheduler::sleepUntil(std::chrono::steady_clock::now() + std::chrono::milliseconds(ms));
+    }
+
+#if defined(_WIN32) && !defined(KMSL_NULL_IO)
+    void IoController::readCursor(int& x, int& y)
+    {
+        POINT p;
+        if (GetCursorPos(&p))
+        {
+            x = p.x;
+            y = p.y;
+        }
+    }
+
+    void IoController::sendInputs(const std::vector<PendingInput>& pendingInputs)
+    {
+        // a single move keeps the exact SetCursorPos
+        if (pendingInputs.size() == 1 && pendingInputs[0].kind == PendingInput::Kind::MOVE)
+        {
+            SetCursorPos(pendingInputs[0].x, pendingInputs[0].y);
+            InputState::onMove(pendingInputs[0].x, pendingInputs[0].y); // SetCursorPos does not go through the low-level mouse hook
+            return;
+        }
+
+        std::vector<INPUT> inputs;
+        const PendingInput* lastMove = nullptr;
+
+        for (const PendingInput& pending : pendingInputs) {
+            if (pending.kind == PendingInput::Kind::MOVE) {
+                inputs.push_back(createMoveInput(pending.x, pending.y));
+                lastMove = &pending;
+            }
+            else if (pending.kind == PendingInput::Kind::SCROLL) {
+                INPUT input;
+                ZeroMemory(&input, sizeof(INPUT));
+                input.type = INPUT_MOUSE;
+                input.mi.dwFlags = MOUSEEVENTF_WHEEL;
+                input.mi.mouseData = pending.x;
+                inputs.push_back(input);
+            }
+            else if (pending.key_code >= VK_LBUTTON && pending.key_code <= VK_XBUTTON2) {
+                bool down = pending.down;
+                DWORD mouseFlags;
+                switch (pending.key_code) {
+                case VK_LBUTTON: mouseFlags = down ? MOUSEEVENTF_LEFTDOWN : MOUSEEVENTF_LEFTUP; break;
+                case VK_RBUTTON: mouseFlags = down ? MOUSEEVENTF_RIGHTDOWN : MOUSEEVENTF_RIGHTUP; break;
+                case VK_MBUTTON: mouseFlags = down ? MOUSEEVENTF_MIDDLEDOWN : MOUSEEVENTF_MIDDLEUP; break;
+                case VK_XBUTTON1: mouseFlags = down ? MOUSEEVENTF_XDOWN : MOUSEEVENTF_XUP; break;
+                case VK_XBUTTON2: mouseFlags = down ? MOUSEEVENTF_XDOWN : MOUSEEVENTF_XUP; break;
+                default: continue;
+                }
+                inputs.push_back(createMouseInput(pending.key_code, mouseFlags));
+            }
+            else {
+                inputs.push_back(createKeyboardInput(pending.key_code, pending.down ? 0 : KEYEVENTF_KEYUP));
+            }
+        }
+
+        SendInput(static_cast<UINT>(inputs.size()), inputs.data(), sizeof(INPUT));
+
+        if (lastMove) // the hook reports it later, GETX should see it right away
+            InputState::onMove(lastMove->x, lastMove->y);
+    }
+
     INPUT IoController::createKeyboardInput(WORD keyCode, DWORD dwFlags)
     {
         INPUT input = { 0 };
@@ -242,4 +417,41 @@ namespace kmsl
         input.mi.dwFlags = dwFlags;
         return input;
     }
+
+    INPUT IoController::createMoveInput(int x, int y)
+    {
+        // absolute SendInput coordinates are 0..65535 over the virtual desktop
+        int left = GetSystemMetrics(SM_XVIRTUALSCREEN);
+        int top = GetSystemMetrics(SM_YVIRTUALSCREEN);
+        int width = std::max(GetSystemMetrics(SM_CXVIRTUALSCREEN) - 1, 1);
+        int height = std::max(GetSystemMetrics(SM_CYVIRTUALSCREEN) - 1, 1);
+
+        INPUT input = { 0 };
+        input.type = INPUT_MOUSE;
+        input.mi.dx = static_cast<LONG>((static_cast<long long>(x - left) * 65535) / width);
+        input.mi.dy = static_cast<LONG>((static_cast<long long>(y - top) * 65535) / height);
+        input.mi.dwFlags = MOUSEEVENTF_MOVE | MOUSEEVENTF_ABSOLUTE | MOUSEEVENTF_VIRTUALDESK;
+        return input;
+    }
+#else
+    // headless backend: there are no real devices, the simulated input is the only source of InputState,
+    // kmsl_bench uses it on windows too (KMSL_NULL_IO), so benchmarks never touch the real mouse
+    void IoController::readCursor(int& x, int& y)
+    {
+        InputState::getCursor(x, y);
+    }
+
+    void IoController::sendInputs(const std::vector<PendingInput>& inputs)
+    {
+        for (const PendingInput& input : inputs)
+        {
+            switch (input.kind)
+            {
+            case PendingInput::Kind::KEY: InputState::onKey(input.key_code, input.down); break;
+            case PendingInput::Kind::MOVE: InputState::onMove(input.x, input.y); break;
+            case PendingInput::Kind::SCROLL: InputState::onScroll(input.x); break;
+            }
+        }
+    }
+#endif
 };
@@ -1,15 +1,24 @@
 ﻿#pragma once
 
-#define NOMINMAX
-
 #include <string>
 #include <map>
+#include <unordered_map>
 #include <vector>
-#include <windows.h>
 #include <algorithm>
 #include <cmath>
 #include <chrono>
 #include <thread>
+#include <atomic>
+#include <ostream>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include "VirtualKeys.hpp"
+#endif
+
+#include "InputState.hpp"
 
 namespace kmsl
 {
@@ -24,12 +33,58 @@ namespace kmsl
 		static void hold(const std::vector<std::string>& buttons);
 		static void release(const std::vector<std::string>& buttons);
 		static bool getState(const std::string& button);
+		static bool waitKey(const std::string& button); // false if the key is unknown
 		static void getMouseCoordinates(int& x, int& y);
+		static WORD getVirtualKeyCode(const std::string& key); // 0 if the key is unknown
+
+		// zero-delay input between beginBatch() and endBatch() is sent with one SendInput,
+		// following absolute moves are collapsed into the last one; batches nest and are per thread
+		static void beginBatch();
+		static void endBatch();
+		static void sendPending(); // sends the batched input now, the batch stays open
+
+		static void printStats(std::ostream& os);
 
 	private:
-		static WORD getVirtualKeyCode(const std::string& key);
+		friend class InputReplayer; // replays on the raw events, the recorded ones are raw too
+
+		struct PendingInput
+		{
+			enum class Kind { KEY, MOVE, SCROLL } kind;
+			WORD key_code;
+			bool down;
+			int x; // MOVE x, SCROLL amount
+			int y;
+		};
+
+		struct Batch
+		{
+			int depth = 0;
+			std::vector<PendingInput> pending;
+		};
+
+		static void getCursor(int& x, int& y); // includes the batched moves
+		static void setCursor(int x, int y);
+		static void sendScroll(int amount);
+		static void sendKeys(const std::vector<WORD>& keyCodes, bool down);
+		static void queue(const PendingInput& input);
+		static void pause(float t); // sleeps t seconds, the batched input goes out before
+
+		// platform layer: SendInput on windows, simulated devices in the headless backend
+		static void readCursor(int& x, int& y);
+		static void sendInputs(const std::vector<PendingInput>& inputs);
+
+#ifdef _WIN32
 		static INPUT createKeyboardInput(WORD keyCode, DWORD dwFlags);
 		static INPUT createMouseInput(WORD keyCode, DWORD dwFlags);
+		static INPUT createMoveInput(int x, int y);
+#endif
+
+		static thread_local Batch batch_;
+
+		/* STATS */
+		static std::atomic<unsigned long long> requested_; // input calls without batching
+		static std::atomic<unsigned long long> issued_; // input calls which were made
 	};
 }
 
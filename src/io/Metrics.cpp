@@ -0,0 +1,265 @@
+#include "Metrics.hpp"
+
+#include <new>
+#include <cstring>
+#include <cstdio>
+#include <ctime>
+#include <iomanip>
+#include <thread>
+
+#ifndef _WIN32
+#include <filesystem>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <cerrno>
+#endif
+
+namespace kmsl
+{
+	Metrics::Page* Metrics::page_(nullptr);
+	std::string Metrics::path_;
+#ifdef _WIN32
+	HANDLE Metrics::mapping_(nullptr);
+#endif
+
+	static const char magic[8] = { 'K', 'M', 'S', 'L', 'M', 'E', 'T', '\0' };
+
+	bool Metrics::publish(const std::string& script)
+	{
+#ifdef _WIN32
+		long long pid = GetCurrentProcessId();
+		mapping_ = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, sizeof(Page), name(pid).c_str());
+		if (!mapping_)
+			return false;
+
+		void* memory = MapViewOfFile(mapping_, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(Page));
+		if (!memory)
+		{
+			CloseHandle(mapping_);
+			mapping_ = nullptr;
+			return false;
+		}
+#else
+		long long pid = getpid();
+		path_ = name(pid);
+
+		// a fresh file only for the user, never one (or a symlink) someone else put there
+		int fd = open(path_.c_str(), O_RDWR | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0600);
+		if (fd < 0 && errno == EEXIST && unlink(path_.c_str()) == 0) // left by a crashed process with the same pid
+			fd = open(path_.c_str(), O_RDWR | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0600);
+		if (fd < 0)
+			return false;
+
+		void* memory = MAP_FAILED;
+		if (ftruncate(fd, sizeof(Page)) == 0)
+			memory = mmap(nullptr, sizeof(Page), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		close(fd);
+
+		if (memory == MAP_FAILED)
+		{
+			unlink(path_.c_str());
+			return false;
+		}
+#endif
+
+		Page* page = new (memory) Page(); // the new page is zeroed
+		page->version = version_;
+		page->pid = static_cast<uint32_t>(pid);
+		page->started = static_cast<int64_t>(std::time(nullptr));
+		std::strncpy(page->script, script.c_str(), sizeof(page->script) - 1);
+		page->running.store(1);
+
+		std::atomic_thread_fence(std::memory_order_release);
+		std::memcpy(page->magic, magic, sizeof(magic));
+
+		page_ = page;
+		return true;
+	}
+
+	void Metrics::unpublish()
+	{
+		if (!page_)
+			return;
+
+		Page* page = page_;
+		page_ = nullptr;
+		page->running.store(0);
+
+#ifdef _WIN32
+		UnmapViewOfFile(page);
+		CloseHandle(mapping_);
+		mapping_ = nullptr;
+#else
+		munmap(page, sizeof(Page));
+		unlink(path_.c_str());
+#endif
+	}
+
+	int Metrics::top(long long pid, std::ostream& os)
+	{
+		const Page* page = nullptr;
+
+#ifdef _WIN32
+		HANDLE mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, name(pid).c_str());
+		if (mapping)
+			page = static_cast<const Page*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, sizeof(Page)));
+#else
+		int fd = open(name(pid).c_str(), O_RDONLY);
+		if (fd >= 0)
+		{
+			struct stat st;
+			if (fstat(fd, &st) == 0 && st.st_size >= static_cast<off_t>(sizeof(Page)))
+			{
+				void* memory = mmap(nullptr, sizeof(Page), PROT_READ, MAP_SHARED, fd, 0);
+				if (memory != MAP_FAILED)
+					page = static_cast<const Page*>(memory);
+			}
+			close(fd);
+		}
+#endif
+
+		if (!page || std::memcmp(page->magic, magic, sizeof(magic)) != 0 || page->version != version_)
+		{
+			os << "Error: no KMSL process " << pid << " with --metrics" << std::endl;
+			return 1;
+		}
+		std::atomic_thread_fence(std::memory_order_acquire);
+
+		Sample before = sample(page);
+		auto last = std::chrono::steady_clock::now();
+		print(os, page, before, before, 0);
+
+		while (page->running.load() && alive(pid))
+		{
+			std::this_thread::sleep_for(std::chrono::seconds(1));
+
+			Sample now = sample(page);
+			auto time = std::chrono::steady_clock::now();
+			print(os, page, now, before, std::chrono::duration<double>(time - last).count());
+
+			before = now;
+			last = time;
+		}
+		os << "the script has ended" << std::endl;
+
+#ifdef _WIN32
+		UnmapViewOfFile(page);
+		CloseHandle(mapping);
+#else
+		munmap(const_cast<Page*>(page), sizeof(Page));
+#endif
+		return 0;
+	}
+
+	void Metrics::addIteration(std::chrono::steady_clock::duration time)
+	{
+		Page* page = page_;
+		if (!page)
+			return;
+
+		long long us = std::chrono::duration_cast<std::chrono::microseconds>(time).count();
+		size_t bucket = 0;
+		while (us > 0 && bucket < buckets_ - 1)
+		{
+			us >>= 1;
+			bucket++;
+		}
+
+		page->counters[static_cast<size_t>(Counter::LOOP_ITERATIONS)].fetch_add(1, std::memory_order_relaxed);
+		page->latency[bucket].fetch_add(1, std::memory_order_relaxed);
+	}
+
+	std::string Metrics::name(long long pid)
+	{
+#ifdef _WIN32
+		return "Local\\kmsl-metrics-" + std::to_string(pid);
+#else
+		std::error_code error;
+		std::filesystem::path dir = std::filesystem::temp_directory_path(error);
+		if (error)
+			dir = "/tmp";
+		return (dir / ("kmsl-" + std::to_string(pid) + ".metrics")).string();
+#endif
+	}
+
+	bool Metrics::alive(long long pid)
+	{
+#ifdef _WIN32
+		HANDLE process = OpenProcess(SYNCHRONIZE, FALSE, static_cast<DWORD>(pid));
+		if (!process)
+			return false;
+
+		bool running = WaitForSingleObject(process, 0) == WAIT_TIMEOUT;
+		CloseHandle(process);
+		return running;
+#else
+		return kill(static_cast<pid_t>(pid), 0) == 0 || errno == EPERM;
+#endif
+	}
+
+	Metrics::Sample Metrics::sample(const Page* page)
+	{
+		Sample s;
+		for (size_t i = 0; i < static_cast<size_t>(Counter::COUNT); i++)
+			s.counters[i] = page->counters[i].load(std::memory_order_relaxed);
+		for (size_t i = 0; i < buckets_; i++)
+			s.latency[i] = page->latency[i].load(std::memory_order_relaxed);
+		return s;
+	}
+
+	uint64_t Metrics::percentile(const uint64_t* latency, uint64_t total, double p)
+	{
+		uint64_t count = 0;
+		for (size_t i = 0; i < buckets_; i++)
+		{
+			count += latency[i];
+			if (count >= total * p)
+				return 1ULL << i;
+		}
+		return 1ULL << (buckets_ - 1);
+	}
+
+	void Metrics::print(std::ostream& os, const Page* page, const Sample& now, const Sample& before, double seconds)
+	{
+		static const char* names[] = { "statements", "loop iterations", "input events", "file operations", "processes", "errors" };
+
+		long long up = static_cast<long long>(std::time(nullptr)) - page->started;
+		char uptime[32];
+		std::snprintf(uptime, sizeof(uptime), "%02lld:%02lld:%02lld", up / 3600, up / 60 % 60, up % 60);
+
+		os << "\x1b[H\x1b[2J"; // clears the terminal
+		os << "KMSL " << page->pid << "  " << page->script << "  up " << uptime << "\n\n";
+		os << std::left << std::setw(20) << "" << std::right << std::setw(14) << "total" << std::setw(14) << "per second" << '\n';
+
+		for (size_t i = 0; i < static_cast<size_t>(Counter::COUNT); i++)
+		{
+			os << std::left << std::setw(20) << names[i] << std::right << std::setw(14) << now.counters[i] << std::setw(14);
+			if (seconds > 0)
+				os << std::fixed << std::setprecision(1) << (now.counters[i] - before.counters[i]) / seconds;
+			else
+				os << '-';
+			os << '\n';
+		}
+
+		uint64_t latency[buckets_];
+		uint64_t iterations = 0;
+		for (size_t i = 0; i < buckets_; i++)
+		{
+			latency[i] = now.latency[i] - before.latency[i];
+			iterations += latency[i];
+		}
+
+		os << "\nloop latency: ";
+		if (iterations > 0)
+			os << iterations << " iterations, p50 <= " << percentile(latency, iterations, 0.5) << " us, p99 <= "
+				<< percentile(latency, iterations, 0.99) << " us";
+		else
+			os << "no iterations";
+		os << " since the last update" << std::endl;
+
+		os.unsetf(std::ios::floatfield);
+	}
+}
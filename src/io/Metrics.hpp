@@ -0,0 +1,101 @@
+#pragma once
+
+#include <string>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+namespace kmsl
+{
+	// --metrics: live counters of a running script in a small shared memory page, kmsl --top <pid> shows them
+	// the counters are atomics right in the page, so publishing costs nothing but the increments themselves
+	// the page is the file <temp dir>/kmsl-<pid>.metrics (Local\kmsl-metrics-<pid> on windows)
+	class Metrics
+	{
+	public:
+		enum class Counter { STATEMENTS, LOOP_ITERATIONS, INPUT_EVENTS, FILE_OPERATIONS, PROCESSES, ERRORS, COUNT };
+
+		// times the iterations of one loop, reads the clock only with --metrics
+		class Loop
+		{
+		public:
+			Loop() : enabled_(Metrics::enabled())
+			{
+				if (enabled_)
+					last_ = std::chrono::steady_clock::now();
+			}
+
+			void next()
+			{
+				if (!enabled_)
+					return;
+
+				auto now = std::chrono::steady_clock::now();
+				Metrics::addIteration(now - last_);
+				last_ = now;
+			}
+
+		private:
+			bool enabled_;
+			std::chrono::steady_clock::time_point last_;
+		};
+
+		static bool publish(const std::string& script); // false if the page can not be created
+		static void unpublish(); // marks the script as finished and removes the page
+
+		static bool enabled() { return page_ != nullptr; }
+
+		static void add(Counter counter, uint64_t n = 1)
+		{
+			if (page_)
+				page_->counters[static_cast<size_t>(counter)].fetch_add(n, std::memory_order_relaxed);
+		}
+
+		// kmsl --top: shows the metrics of the process every second until it ends, returns the exit code
+		static int top(long long pid, std::ostream& os);
+
+	private:
+		static constexpr size_t buckets_ = 32; // bucket i: iterations of 2^(i-1) to 2^i microseconds, 0: below 1
+		static constexpr uint32_t version_ = 1;
+
+		struct Page
+		{
+			char magic[8]; // written last, the viewer ignores a page without it
+			uint32_t version;
+			uint32_t pid;
+			int64_t started; // unix time
+			char script[256];
+			std::atomic<uint32_t> running;
+			std::atomic<uint64_t> counters[static_cast<size_t>(Counter::COUNT)];
+			std::atomic<uint64_t> latency[buckets_];
+		};
+
+		static_assert(std::atomic<uint64_t>::is_always_lock_free, "the metrics page needs lock-free 64-bit atomics");
+
+		struct Sample
+		{
+			uint64_t counters[static_cast<size_t>(Counter::COUNT)];
+			uint64_t latency[buckets_];
+		};
+
+		static void addIteration(std::chrono::steady_clock::duration time);
+
+		static std::string name(long long pid); // file or mapping of the page
+		static bool alive(long long pid);
+		static Sample sample(const Page* page);
+		static uint64_t percentile(const uint64_t* latency, uint64_t total, double p); // upper bound in microseconds
+		static void print(std::ostream& os, const Page* page, const Sample& now, const Sample& before, double seconds);
+
+		static Page* page_;
+		static std::string path_;
+#ifdef _WIN32
+		static HANDLE mapping_;
+#endif
+	};
+}
@@ -0,0 +1,167 @@
+#include "OutputSink.hpp"
+
+#ifdef _WIN32
+#include <io.h>
+#define isatty _isatty
+#define fileno _fileno
+#else
+#include <unistd.h>
+#endif
+
+namespace kmsl
+{
+	namespace
+	{
+		const size_t max_queued = 4; // the interpreter waits when the writer is that far behind
+	}
+
+	OutputSink::OutputSink(std::FILE* file, size_t capacity)
+		: file_(file), interactive_(isatty(fileno(file)) != 0), capacity_(capacity),
+		writing_(false), stop_(false), bytes_(0), writes_(0)
+	{
+		buffer_.reserve(capacity_);
+	}
+
+	OutputSink::~OutputSink()
+	{
+		flush();
+		setWriterThread(false);
+	}
+
+	void OutputSink::write(const std::string& text)
+	{
+		buffer_ += text;
+		written(interactive_ && text.find('\n') != std::string::npos);
+	}
+
+	void OutputSink::write(const char* text)
+	{
+		write(std::string(text));
+	}
+
+	void OutputSink::write(char c)
+	{
+		buffer_ += c;
+		written(interactive_ && c == '\n');
+	}
+
+	void OutputSink::write(int value)
+	{
+		Convert::append(buffer_, value);
+		written(false);
+	}
+
+	void OutputSink::write(float value)
+	{
+		Convert::append(buffer_, value);
+		written(false);
+	}
+
+	void OutputSink::written(bool newline)
+	{
+		if (newline || buffer_.size() >= capacity_)
+			commit();
+	}
+
+	void OutputSink::flush()
+	{
+		commit();
+
+		if (writer_.joinable())
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			changed_.wait(lock, [&] { return queue_.empty() && !writing_; });
+		}
+	}
+
+	void OutputSink::idle()
+	{
+		if (interactive_)
+			flush();
+	}
+
+	void OutputSink::setWriterThread(bool enabled)
+	{
+		if (enabled == writer_.joinable())
+			return;
+
+		flush();
+
+		if (enabled)
+		{
+			stop_ = false;
+			writer_ = std::thread(&OutputSink::writerLoop, this);
+		}
+		else
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				stop_ = true;
+			}
+			changed_.notify_all();
+			writer_.join();
+		}
+	}
+
+	void OutputSink::printStats(std::ostream& os) const
+	{
+		os << "output: " << bytes_ << " bytes in " << writes_ << " writes" << (writer_.joinable() ? " (writer thread)" : "") << std::endl;
+	}
+
+	void OutputSink::commit()
+	{
+		if (buffer_.empty())
+			return;
+
+		bytes_ += buffer_.size();
+		writes_++;
+
+		if (writer_.joinable())
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			changed_.wait(lock, [&] { return queue_.size() < max_queued; });
+			queue_.push_back(std::move(buffer_));
+			lock.unlock();
+			changed_.notify_all();
+
+			buffer_ = std::string();
+			buffer_.reserve(capacity_);
+		}
+		else
+		{
+			writeFile(buffer_);
+			buffer_.clear();
+		}
+	}
+
+	void OutputSink::writeFile(const std::string& data)
+	{
+		std::fwrite(data.data(), 1, data.size(), file_);
+		std::fflush(file_);
+	}
+
+	void OutputSink::writerLoop()
+	{
+		Trace::setThreadName("output");
+		std::unique_lock<std::mutex> lock(mutex_);
+
+		while (true)
+		{
+			changed_.wait(lock, [&] { return !queue_.empty() || stop_; });
+			if (queue_.empty()) // stop_
+				break;
+
+			std::string data = std::move(queue_.front());
+			queue_.pop_front();
+			writing_ = true;
+			lock.unlock();
+			changed_.notify_all(); // room in the queue
+
+			writeFile(data);
+
+			lock.lock();
+			writing_ = false;
+			changed_.notify_all(); // for flush()
+		}
+	}
+}
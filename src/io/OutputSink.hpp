@@ -0,0 +1,62 @@
+#pragma once
+
+#include <string>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <ostream>
+#include <cstdio>
+
+#include "../interpreter/Convert.hpp"
+#include "Trace.hpp"
+
+namespace kmsl
+{
+	// buffered stdout of the interpreter: PRINT, the console and --log write here instead of std::cout
+	// on a terminal the buffer goes out with every line, otherwise when it is full
+	// with the writer thread the interpreter only hands the full buffer over and continues
+	class OutputSink
+	{
+	public:
+		explicit OutputSink(std::FILE* file = stdout, size_t capacity = 1 << 16);
+		~OutputSink();
+
+		void write(const std::string& text);
+		void write(const char* text);
+		void write(char c);
+		void write(int value);
+		void write(float value);
+
+		void flush(); // before INPUT, OS and exit, the output is in the file afterwards
+		void idle(); // before waiting, flushes only on a terminal
+
+		void setWriterThread(bool enabled);
+		bool isInteractive() const { return interactive_; }
+
+		void printStats(std::ostream& os) const;
+
+	private:
+		void written(bool newline); // applies the flush policy after a write
+		void commit(); // hands the buffer to the file or the writer thread
+		void writeFile(const std::string& data);
+		void writerLoop();
+
+		std::FILE* file_;
+		bool interactive_;
+		size_t capacity_;
+		std::string buffer_;
+
+		// writer thread
+		std::thread writer_;
+		std::mutex mutex_;
+		std::condition_variable changed_;
+		std::deque<std::string> queue_; // full buffers, bounded by max_queued
+		bool writing_;
+		bool stop_;
+
+		/* STATS */
+		unsigned long long bytes_;
+		unsigned long long writes_;
+	};
+}
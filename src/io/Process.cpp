@@ -0,0 +1,222 @@
+#include "Process.hpp"
+
+#ifndef _WIN32
+#include <spawn.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <cerrno>
+#include <cstring>
+
+extern char** environ;
+#endif
+
+namespace kmsl
+{
+#ifdef _WIN32
+	ProcessResult Process::run(const std::vector<std::string>& argv, double timeout)
+	{
+		ProcessResult result;
+
+		SECURITY_ATTRIBUTES sa{ sizeof(SECURITY_ATTRIBUTES), NULL, TRUE };
+		HANDLE readPipe, writePipe;
+		if (!CreatePipe(&readPipe, &writePipe, &sa, 0))
+		{
+			result.error = "cannot create a pipe";
+			return result;
+		}
+		SetHandleInformation(readPipe, HANDLE_FLAG_INHERIT, 0); // only the child end is inherited
+
+		STARTUPINFOA si{};
+		si.cb = sizeof(si);
+		si.dwFlags = STARTF_USESTDHANDLES;
+		si.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+		si.hStdOutput = writePipe;
+		si.hStdError = GetStdHandle(STD_ERROR_HANDLE);
+
+		PROCESS_INFORMATION pi{};
+		std::string cmd = commandLine(argv);
+		if (!CreateProcessA(NULL, cmd.data(), NULL, NULL, TRUE, 0, NULL, NULL, &si, &pi))
+		{
+			CloseHandle(readPipe);
+			CloseHandle(writePipe);
+			result.error = "'" + argv[0] + "' cannot be started";
+			return result;
+		}
+		CloseHandle(writePipe);
+		CloseHandle(pi.hThread);
+
+		// the pipe is drained on its own thread, a full pipe would block the child
+		std::thread reader([&]
+		{
+			char buffer[4096];
+			DWORD n;
+			while (ReadFile(readPipe, buffer, sizeof(buffer), &n, NULL) && n > 0)
+				result.output.append(buffer, n);
+		});
+
+		DWORD wait = timeout > 0 ? static_cast<DWORD>(timeout * 1000) : INFINITE;
+		if (WaitForSingleObject(pi.hProcess, wait) == WAIT_TIMEOUT)
+		{
+			TerminateProcess(pi.hProcess, 1);
+			WaitForSingleObject(pi.hProcess, INFINITE);
+			result.timed_out = true;
+		}
+
+		reader.join();
+
+		DWORD code = 0;
+		GetExitCodeProcess(pi.hProcess, &code);
+		result.exit_code = result.timed_out ? -1 : static_cast<int>(code);
+
+		CloseHandle(pi.hProcess);
+		CloseHandle(readPipe);
+		trimOutput(result.output);
+		return result;
+	}
+
+	std::string Process::commandLine(const std::vector<std::string>& argv)
+	{
+		std::string cmd;
+
+		for (const std::string& arg : argv)
+		{
+			if (!cmd.empty())
+				cmd += ' ';
+
+			if (!arg.empty() && arg.find_first_of(" \t\"") == std::string::npos)
+			{
+				cmd += arg;
+				continue;
+			}
+
+			cmd += '"';
+			size_t backslashes = 0;
+			for (char c : arg)
+			{
+				if (c == '\\')
+					backslashes++;
+				else
+				{
+					if (c == '"')
+						cmd.append(backslashes + 1, '\\'); // escape the backslashes in front of the quote and the quote
+					backslashes = 0;
+				}
+				cmd += c;
+			}
+			cmd.append(backslashes, '\\'); // before the closing quote
+			cmd += '"';
+		}
+
+		return cmd;
+	}
+#else
+	ProcessResult Process::run(const std::vector<std::string>& argv, double timeout)
+	{
+		ProcessResult result;
+
+		int fds[2];
+		if (::pipe2(fds, O_CLOEXEC) == -1)
+		{
+			result.error = "cannot create a pipe";
+			return result;
+		}
+
+		posix_spawn_file_actions_t actions;
+		posix_spawn_file_actions_init(&actions);
+		posix_spawn_file_actions_adddup2(&actions, fds[1], STDOUT_FILENO); // dup2 clears O_CLOEXEC on the copy
+
+		std::vector<char*> args;
+		for (const std::string& arg : argv)
+			args.push_back(const_cast<char*>(arg.c_str()));
+		args.push_back(nullptr);
+
+		pid_t pid;
+		int error = posix_spawnp(&pid, args[0], &actions, nullptr, args.data(), environ);
+		posix_spawn_file_actions_destroy(&actions);
+		::close(fds[1]);
+
+		if (error != 0)
+		{
+			::close(fds[0]);
+			result.error = "'" + argv[0] + "' cannot be started: " + std::strerror(error);
+			return result;
+		}
+
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(timeout));
+		char buffer[4096];
+
+		while (true)
+		{
+			int wait_ms = -1;
+			if (timeout > 0)
+			{
+				auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+				wait_ms = static_cast<int>(std::max<long long>(left, 0));
+			}
+
+			pollfd pfd{ fds[0], POLLIN, 0 };
+			int ready = ::poll(&pfd, 1, wait_ms);
+			if (ready == 0)
+			{
+				::kill(pid, SIGKILL);
+				result.timed_out = true;
+				break;
+			}
+			if (ready < 0 && errno == EINTR)
+				continue;
+
+			ssize_t n = ::read(fds[0], buffer, sizeof(buffer));
+			if (n < 0 && errno == EINTR)
+				continue;
+			if (n <= 0)
+				break; // the child closed its stdout
+			result.output.append(buffer, static_cast<size_t>(n));
+		}
+		::close(fds[0]);
+
+		int status = 0;
+		if (timeout > 0 && !result.timed_out)
+		{
+			// the child may close its stdout and go on, the deadline still holds
+			auto pause = std::chrono::milliseconds(1);
+			while (true)
+			{
+				pid_t done = ::waitpid(pid, &status, WNOHANG);
+				if (done == pid || (done == -1 && errno != EINTR))
+					break;
+				if (std::chrono::steady_clock::now() >= deadline)
+				{
+					::kill(pid, SIGKILL);
+					result.timed_out = true;
+					break;
+				}
+
+				std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(pause, deadline - std::chrono::steady_clock::now()));
+				pause = std::min(pause * 2, std::chrono::milliseconds(10));
+			}
+		}
+
+		if (result.timed_out || timeout <= 0)
+			while (::waitpid(pid, &status, 0) == -1 && errno == EINTR);
+
+		if (result.timed_out)
+			result.exit_code = -1;
+		else if (WIFEXITED(status))
+			result.exit_code = WEXITSTATUS(status);
+		else if (WIFSIGNALED(status))
+			result.exit_code = 128 + WTERMSIG(status);
+
+		trimOutput(result.output);
+		return result;
+	}
+#endif
+
+	void Process::trimOutput(std::string& output)
+	{
+		while (!output.empty() && (output.back() == '\n' || output.back() == '\r'))
+			output.pop_back();
+	}
+}
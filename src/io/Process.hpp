@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+namespace kmsl
+{
+	struct ProcessResult
+	{
+		std::string output; // stdout without the trailing newlines, stderr goes to ours
+		int exit_code = -1; // -1 after a timeout, 128 + n if killed by signal n
+		bool timed_out = false;
+		std::string error; // the process could not be started
+	};
+
+	// EXEC: starts a program without a shell (posix_spawnp/CreateProcess) and collects its stdout
+	class Process
+	{
+	public:
+		// argv[0] is searched in PATH, timeout <= 0 waits forever
+		static ProcessResult run(const std::vector<std::string>& argv, double timeout);
+
+	private:
+		static void trimOutput(std::string& output); // like $(...) in a shell
+
+#ifdef _WIN32
+		static std::string commandLine(const std::vector<std::string>& argv); // quoted like CommandLineToArgvW expects
+#endif
+	};
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+
+namespace kmsl
+{
+	// lock-free ring buffer for exactly one producer thread and one consumer thread
+	// Capacity has to be a power of two, one slot always stays free to tell full from empty
+	template<typename T, size_t Capacity>
+	class SpscQueue
+	{
+		static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+	public:
+		SpscQueue() : buffer_(Capacity), head_(0), tail_(0) {}
+
+		// producer side, returns false when the ring is full (item is not touched then)
+		bool push(T&& item)
+		{
+			size_t tail = tail_.load(std::memory_order_relaxed);
+			size_t next = (tail + 1) & (Capacity - 1);
+
+			if (next == head_.load(std::memory_order_acquire))
+				return false;
+
+			buffer_[tail] = std::move(item);
+			tail_.store(next, std::memory_order_release);
+			return true;
+		}
+
+		// consumer side, returns false when the ring is empty
+		bool pop(T& item)
+		{
+			size_t head = head_.load(std::memory_order_relaxed);
+
+			if (head == tail_.load(std::memory_order_acquire))
+				return false;
+
+			item = std::move(buffer_[head]);
+			head_.store((head + 1) & (Capacity - 1), std::memory_order_release);
+			return true;
+		}
+
+		size_t size() const
+		{
+			size_t tail = tail_.load(std::memory_order_acquire);
+			size_t head = head_.load(std::memory_order_acquire);
+			return (tail - head) & (Capacity - 1);
+		}
+
+		bool empty() const { return size() == 0; }
+		static constexpr size_t capacity() { return Capacity - 1; }
+
+	private:
+		std::vector<T> buffer_;
+		alignas(64) std::atomic<size_t> head_; // written only by the consumer
+		alignas(64) std::atomic<size_t> tail_; // written only by the producer
+	};
+}
@@ -0,0 +1,254 @@
+#include "Trace.hpp"
+
+namespace kmsl
+{
+	std::atomic<bool> Trace::enabled_(false);
+	std::chrono::steady_clock::time_point Trace::start_;
+	std::FILE* Trace::file_(nullptr);
+	bool Trace::first_event_(true);
+	std::mutex Trace::buffers_mutex_;
+	std::vector<std::shared_ptr<Trace::Buffer>> Trace::buffers_;
+	std::atomic<uint32_t> Trace::next_tid_(1);
+	std::thread Trace::writer_;
+	std::mutex Trace::writer_mutex_;
+	std::condition_variable Trace::wake_;
+	bool Trace::stopping_(false);
+
+	void Trace::Span::begin(const char* category, const char* name)
+	{
+		active_ = Trace::enabled();
+		if (!active_)
+			return;
+
+		category_ = category;
+		copy(name_, sizeof(name_), name);
+		args_[0] = '\0';
+		start_ = now();
+	}
+
+	void Trace::Span::end()
+	{
+		if (!Trace::enabled()) // stopped meanwhile
+			return;
+
+		Event event;
+		event.phase = 'X';
+		event.ts = start_;
+		event.dur = now() - start_;
+		event.category = category_;
+		copy(event.name, sizeof(event.name), name_);
+		copy(event.args, sizeof(event.args), args_);
+		push(event);
+	}
+
+	void Trace::Span::args(const char* format, ...)
+	{
+		if (!active_)
+			return;
+
+		va_list list;
+		va_start(list, format);
+		std::vsnprintf(args_, sizeof(args_), format, list);
+		va_end(list);
+	}
+
+	bool Trace::start(const std::string& path)
+	{
+		file_ = std::fopen(path.c_str(), "wb");
+		if (!file_)
+			return false;
+
+		std::fputs("{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n", file_);
+		start_ = std::chrono::steady_clock::now();
+		stopping_ = false;
+		enabled_.store(true, std::memory_order_release);
+		setThreadName("main");
+
+		writer_ = std::thread(writer);
+		return true;
+	}
+
+	void Trace::stop()
+	{
+		if (!enabled())
+			return;
+
+		enabled_.store(false, std::memory_order_release);
+		{
+			std::lock_guard<std::mutex> lock(writer_mutex_);
+			stopping_ = true;
+		}
+		wake_.notify_one();
+		writer_.join();
+
+		std::fputs("\n]}\n", file_);
+		std::fclose(file_);
+		file_ = nullptr;
+	}
+
+	void Trace::instant(const char* category, const std::string& name, const std::string& message, int line)
+	{
+		if (!enabled())
+			return;
+
+		Event event;
+		event.phase = 'i';
+		event.ts = now();
+		event.dur = 0;
+		event.category = category;
+		copy(event.name, sizeof(event.name), name.c_str());
+
+		std::string args = "\"message\": \"" + escape(message) + '"';
+		if (line > 0)
+			args = "\"line\": " + std::to_string(line) + ", " + args;
+		copy(event.args, sizeof(event.args), args.c_str());
+
+		push(event);
+	}
+
+	std::string Trace::escape(const std::string& s, size_t max)
+	{
+		std::string escaped;
+		escaped.reserve(s.size());
+		for (char c : s)
+		{
+			if (escaped.size() + 2 > max)
+				break;
+			if (c == '"' || c == '\\')
+				escaped += '\\';
+			if (static_cast<unsigned char>(c) >= 0x20)
+				escaped += c;
+		}
+		return escaped;
+	}
+
+	void Trace::setThreadName(const std::string& name)
+	{
+		if (!enabled())
+			return;
+
+		Buffer& b = buffer();
+		std::lock_guard<std::mutex> lock(b.name_mutex);
+		b.name = name;
+	}
+
+	void Trace::printStats(std::ostream& os)
+	{
+		unsigned long long dropped = 0;
+		size_t threads;
+		{
+			std::lock_guard<std::mutex> lock(buffers_mutex_);
+			threads = buffers_.size();
+			for (const auto& b : buffers_)
+				dropped += b->dropped.load();
+		}
+
+		os << "trace: " << threads << " threads, " << dropped << " events dropped" << std::endl;
+	}
+
+	uint64_t Trace::now()
+	{
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_).count());
+	}
+
+	void Trace::push(Event& event)
+	{
+		Buffer& b = buffer();
+
+		// a full ring loses the event instead of waiting for the writer
+		if (!b.events.push(std::move(event)))
+			b.dropped.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	Trace::Buffer& Trace::buffer()
+	{
+		thread_local std::shared_ptr<Buffer> local;
+		if (!local)
+		{
+			local = std::make_shared<Buffer>();
+			local->tid = next_tid_.fetch_add(1);
+			local->name = "thread " + std::to_string(local->tid);
+
+			std::lock_guard<std::mutex> lock(buffers_mutex_);
+			buffers_.push_back(local);
+		}
+		return *local;
+	}
+
+	void Trace::writer()
+	{
+		std::unique_lock<std::mutex> lock(writer_mutex_);
+		while (!stopping_)
+		{
+			wake_.wait_for(lock, std::chrono::milliseconds(50), [] { return stopping_; });
+
+			lock.unlock();
+			drain();
+			lock.lock();
+		}
+
+		lock.unlock();
+		drain(); // the events from before stop()
+
+		// names of the threads, by tid
+		std::lock_guard<std::mutex> buffers_lock(buffers_mutex_);
+		for (const auto& b : buffers_)
+		{
+			std::lock_guard<std::mutex> name_lock(b->name_mutex);
+			std::fprintf(file_, ",\n{\"ph\": \"M\", \"name\": \"thread_name\", \"pid\": 1, \"tid\": %u, \"args\": {\"name\": \"", b->tid);
+			writeString(b->name.c_str());
+			std::fputs("\"}}", file_);
+		}
+	}
+
+	void Trace::drain()
+	{
+		std::vector<std::shared_ptr<Buffer>> buffers;
+		{
+			std::lock_guard<std::mutex> lock(buffers_mutex_);
+			buffers = buffers_;
+		}
+
+		Event event;
+		for (const auto& b : buffers)
+			while (b->events.pop(event))
+				writeEvent(event, b->tid);
+		std::fflush(file_);
+	}
+
+	void Trace::writeEvent(const Event& event, uint32_t tid)
+	{
+		std::fputs(first_event_ ? "" : ",\n", file_);
+		first_event_ = false;
+
+		std::fprintf(file_, "{\"ph\": \"%c\", \"cat\": \"%s\", \"name\": \"", event.phase, event.category);
+		writeString(event.name);
+		std::fprintf(file_, "\", \"pid\": 1, \"tid\": %u, \"ts\": %.3f", tid, event.ts / 1000.0);
+
+		if (event.phase == 'X')
+			std::fprintf(file_, ", \"dur\": %.3f", event.dur / 1000.0);
+		else
+			std::fputs(", \"s\": \"t\"", file_);
+
+		std::fprintf(file_, ", \"args\": {%s}}", event.args);
+	}
+
+	void Trace::writeString(const char* s)
+	{
+		for (; *s; s++)
+		{
+			if (*s == '"' || *s == '\\')
+				std::fputc('\\', file_);
+			if (static_cast<unsigned char>(*s) >= 0x20)
+				std::fputc(*s, file_);
+		}
+	}
+
+	void Trace::copy(char* to, size_t size, const char* from)
+	{
+		size_t i = 0;
+		for (; i + 1 < size && from[i]; i++)
+			to[i] = from[i];
+		to[i] = '\0';
+	}
+}
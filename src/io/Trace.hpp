@@ -0,0 +1,109 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <cstdio>
+#include <cstdarg>
+#include <cstdint>
+#include <ostream>
+
+#include "SpscQueue.hpp"
+
+namespace kmsl
+{
+	// --trace: a timeline in the chrome trace event format (chrome://tracing, ui.perfetto.dev)
+	// every thread writes its events into its own lock-free ring, a background thread
+	// empties the rings into the file, so tracing costs the traced code no locks and no I/O
+	class Trace
+	{
+	public:
+		// a span from its construction (or begin) to its destruction, nothing happens without --trace
+		class Span
+		{
+		public:
+			Span() : active_(false) {}
+			Span(const char* category, const char* name) : active_(false) { begin(category, name); }
+			~Span()
+			{
+				if (active_)
+					end();
+			}
+
+			Span(const Span&) = delete;
+			Span& operator=(const Span&) = delete;
+
+			void begin(const char* category, const char* name); // for spans whose name costs something to make
+			bool active() const { return active_; }
+			void args(const char* format, ...); // printf-like body of the JSON args object, e.g. "\"x\": %d"
+
+		private:
+			void end();
+
+			bool active_;
+			uint64_t start_;
+			const char* category_;
+			char name_[40];
+			char args_[120];
+		};
+
+		static bool start(const std::string& path); // false if the file can not be opened
+		static void stop(); // writes the rest and closes the file
+
+		static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+
+		static void instant(const char* category, const std::string& name, const std::string& message = "", int line = 0);
+		static std::string escape(const std::string& s, size_t max = 64); // for strings in the args of a span, cut to fit
+		static void setThreadName(const std::string& name); // shown instead of "thread N"
+
+		static void printStats(std::ostream& os); // the traced threads and the events lost to full rings
+
+	private:
+		struct Event
+		{
+			char phase; // 'X' span, 'i' instant
+			uint64_t ts; // ns since start()
+			uint64_t dur;
+			const char* category; // string literals only
+			char name[40];
+			char args[120];
+		};
+
+		struct Buffer // its thread produces, the writer consumes
+		{
+			SpscQueue<Event, 4096> events;
+			std::atomic<unsigned long long> dropped{ 0 };
+			uint32_t tid = 0;
+			std::string name;
+			std::mutex name_mutex;
+		};
+
+		static uint64_t now();
+		static void push(Event& event);
+		static Buffer& buffer(); // of this thread
+		static void writer();
+		static void drain(); // writer thread only
+		static void writeEvent(const Event& event, uint32_t tid);
+		static void writeString(const char* s);
+		static void copy(char* to, size_t size, const char* from);
+
+		static std::atomic<bool> enabled_;
+		static std::chrono::steady_clock::time_point start_;
+		static std::FILE* file_;
+		static bool first_event_;
+
+		static std::mutex buffers_mutex_;
+		static std::vector<std::shared_ptr<Buffer>> buffers_; // threads which ended are emptied too
+		static std::atomic<uint32_t> next_tid_;
+
+		static std::thread writer_;
+		static std::mutex writer_mutex_;
+		static std::condition_variable wake_;
+		static bool stopping_;
+	};
+}
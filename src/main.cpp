@@ -1,9 +1,16 @@
 ﻿#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
 
 #include <boost/program_options.hpp>
 
 #include "interpreter/Interpreter.hpp"
 #include "interpreter/FileReader.hpp"
+#include "interpreter/Scheduler.hpp"
+#include "io/InputLog.hpp"
+#include "io/Trace.hpp"
+#include "io/Metrics.hpp"
 
 int main(int argc, char* argv[])
 {
@@ -14,7 +21,25 @@ int main(int argc, char* argv[])
 		("version,v", "show the version of KMSL")
 		("help,h", "Show help message")
 		("log,l", "Enable logging")
-		("file", po::value<std::string>(), "File to execute");
+		("stats,s", "Show runtime statistics at exit")
+		("stats-format", po::value<std::string>()->default_value("text"), "Format of --stats: text or json (only the pipeline phases)")
+		("record,r", po::value<std::string>(), "Record keyboard and mouse input to a .kmrec file")
+		("output-thread", "Write the output on a separate thread (for scripts with a lot of output)")
+		("fs-cache", "Cache READFILE and EXISTS results until the files change")
+		("atomic-write", "WRITEFILE replaces files atomically and makes them durable")
+		("profile", "Profile the script: show the hot lines and write folded stacks for flamegraphs")
+		("profile-out", po::value<std::string>()->default_value("kmsl.folded"), "File for the folded stacks of --profile")
+		("profile-top", po::value<size_t>()->default_value(10), "Number of hot lines and nodes shown by --profile")
+		("trace", po::value<std::string>(), "Write a timeline of statements, builtins, input and errors in the Chrome trace format")
+		("metrics", "Publish live metrics of the script for kmsl --top")
+		("max-steps", po::value<unsigned long long>()->default_value(0), "Stop the script after this many statements and loop iterations (0: no limit)")
+		("timeout", po::value<double>()->default_value(0), "Stop the script after this many seconds (0: no limit)")
+		("max-memory", po::value<size_t>()->default_value(0), "Stop the script when its strings need more MB than this (0: no limit)")
+		("strict-poll", "Run loops which only poll (WHILE !STATE 'F8' { }) at full speed")
+		("poll-latency", po::value<double>()->default_value(2), "Longest pause in ms of a loop which only polls")
+		("multi", po::value<std::vector<std::string>>()->multitoken(), "Run all these files together on one thread, a WAIT only pauses its own script")
+		("top", po::value<long long>(), "Show the live metrics of the KMSL process with this pid (started with --metrics)")
+		("file", po::value<std::string>(), "File to execute, - reads the script from stdin");
 
 	po::positional_options_description p;
 	p.add("file", -1);
@@ -43,24 +68,183 @@ int main(int argc, char* argv[])
 		return 0;
 	}
 
+	if (vm.count("top"))
+		return kmsl::Metrics::top(vm["top"].as<long long>(), std::cout);
+
 	bool logging_enabled = vm.count("log") > 0;
+	bool stats_enabled = vm.count("stats") > 0;
+	std::string stats_format = vm["stats-format"].as<std::string>();
+	if (stats_format != "text" && stats_format != "json")
+	{
+		std::cerr << "Error: --stats-format is text or json\n";
+		return 1;
+	}
+	bool output_thread_enabled = vm.count("output-thread") > 0;
+	bool read_cache_enabled = vm.count("fs-cache") > 0;
+	bool atomic_write_enabled = vm.count("atomic-write") > 0;
+	bool profile_enabled = vm.count("profile") > 0;
+	if (profile_enabled && !vm.count("file") && !vm.count("multi"))
+	{
+		std::cerr << "Error: --profile needs a script file or --multi, the console has no lines to show\n";
+		return 1;
+	}
+	unsigned long long max_steps = vm["max-steps"].as<unsigned long long>();
+	double timeout = vm["timeout"].as<double>();
+	size_t max_memory = vm["max-memory"].as<size_t>() * 1024 * 1024;
+	bool strict_poll = vm.count("strict-poll") > 0;
+	auto poll_latency = std::chrono::microseconds(static_cast<long long>(vm["poll-latency"].as<double>() * 1000));
+
+	std::unique_ptr<kmsl::InputRecorder> recorder;
+	if (vm.count("record"))
+	{
+		std::string recordpath = vm["record"].as<std::string>();
+		recorder = std::make_unique<kmsl::InputRecorder>(recordpath);
+		if (!recorder->isOpen())
+		{
+			std::cerr << "Error: can not open " << recordpath << "\n";
+			return 1;
+		}
+		kmsl::InputState::setRecorder(recorder.get());
+	}
+
+	if (vm.count("trace") && !kmsl::Trace::start(vm["trace"].as<std::string>()))
+	{
+		std::cerr << "Error: can not open " << vm["trace"].as<std::string>() << "\n";
+		return 1;
+	}
+
+	if (vm.count("metrics") && !kmsl::Metrics::publish(vm.count("multi") ? "--multi" : vm.count("file") ? vm["file"].as<std::string>() : "console"))
+	{
+		std::cerr << "Error: can not publish the metrics\n";
+		return 1;
+	}
 	
-	if (vm.count("file"))
+	if (vm.count("multi")) // every script is a task of one scheduler
+	{
+		std::vector<std::string> filepaths = vm["multi"].as<std::vector<std::string>>();
+		std::vector<std::unique_ptr<kmsl::Interpreter>> interpreters;
+		kmsl::Scheduler scheduler;
+
+		for (const std::string& filepath : filepaths)
+		{
+			auto interpreter = std::make_unique<kmsl::Interpreter>();
+			interpreter->setLoggingEnabled(logging_enabled);
+			interpreter->setStatsEnabled(stats_enabled);
+			interpreter->setStatsJson(stats_format == "json");
+			interpreter->setOutputThreadEnabled(output_thread_enabled);
+			interpreter->setReadCacheEnabled(read_cache_enabled);
+			interpreter->setAtomicWriteEnabled(atomic_write_enabled);
+			interpreter->setProfileEnabled(profile_enabled);
+			interpreter->setPolling(strict_poll, poll_latency);
+
+			kmsl::FileReader fr(filepath);
+			interpreter->setCode(fr.read()); // lexed and parsed here, the small stacks of the tasks only run it
+
+			kmsl::Interpreter* script = interpreter.get();
+			scheduler.spawn(filepath, [script, max_steps, timeout, max_memory]()
+			{
+				script->setLimits(max_steps, timeout, max_memory); // --timeout counts from the start of the script
+				script->execute();
+			});
+			interpreters.push_back(std::move(interpreter));
+		}
+
+		scheduler.run();
+
+		if (stats_enabled)
+		{
+			for (size_t i = 0; i < interpreters.size(); i++)
+			{
+				std::cerr << filepaths[i] << ":" << std::endl;
+				interpreters[i]->printStats(std::cerr);
+			}
+			scheduler.printStats(std::cerr);
+		}
+
+		if (profile_enabled) // one file of folded stacks, every script is a root of its own
+		{
+			std::string profilepath = vm["profile-out"].as<std::string>();
+			std::ofstream folded(profilepath);
+			if (!folded.is_open())
+				std::cerr << "Error: can not open " << profilepath << "\n";
+
+			for (size_t i = 0; i < interpreters.size(); i++)
+			{
+				std::string root = filepaths[i]; // spaces and ';' would split the stack
+				std::replace_if(root.begin(), root.end(), [](char c) { return c == ' ' || c == ';'; }, '_');
+				if (folded.is_open())
+					interpreters[i]->writeFoldedProfile(folded, root);
+
+				std::cerr << filepaths[i] << ":" << std::endl;
+				interpreters[i]->printProfile(std::cerr, vm["profile-top"].as<size_t>());
+			}
+		}
+	}
+	else if (vm.count("file"))
 	{
 		std::string filepath = vm["file"].as<std::string>();
-		kmsl::FileReader fr(filepath);
-		std::string code = fr.read();
 		
 		kmsl::Interpreter interpreter;
 		interpreter.setLoggingEnabled(logging_enabled);
-		interpreter.setCode(code);
-		interpreter.execute();
+		interpreter.setStatsEnabled(stats_enabled);
+		interpreter.setStatsJson(stats_format == "json");
+		interpreter.setOutputThreadEnabled(output_thread_enabled);
+		interpreter.setReadCacheEnabled(read_cache_enabled);
+		interpreter.setAtomicWriteEnabled(atomic_write_enabled);
+		interpreter.setProfileEnabled(profile_enabled);
+		interpreter.setLimits(max_steps, timeout, max_memory);
+		interpreter.setPolling(strict_poll, poll_latency);
+
+		if (filepath == "-") // the script comes from stdin, every statement runs as soon as it is complete
+			interpreter.runStream(std::cin);
+		else
+		{
+			kmsl::FileReader fr(filepath);
+			interpreter.setCode(fr.read());
+			interpreter.execute();
+		}
+		interpreter.printStats(std::cerr);
+
+		if (profile_enabled)
+		{
+			std::string profilepath = vm["profile-out"].as<std::string>();
+			std::ofstream folded(profilepath);
+			if (folded.is_open())
+				interpreter.writeFoldedProfile(folded);
+			else
+				std::cerr << "Error: can not open " << profilepath << "\n";
+
+			interpreter.printProfile(std::cerr, vm["profile-top"].as<size_t>());
+		}
+	}
+	else if (recorder) // record the user until ENTER
+	{
+		std::cout << "Recording to " << vm["record"].as<std::string>() << ", press ENTER to stop" << std::endl;
+		std::string line;
+		std::getline(std::cin, line);
 	}
 	else
 	{
 		kmsl::Interpreter interpreter;
 		interpreter.setLoggingEnabled(logging_enabled);
+		interpreter.setStatsEnabled(stats_enabled);
+		interpreter.setStatsJson(stats_format == "json");
+		interpreter.setOutputThreadEnabled(output_thread_enabled);
+		interpreter.setReadCacheEnabled(read_cache_enabled);
+		interpreter.setAtomicWriteEnabled(atomic_write_enabled);
+		interpreter.setLimits(max_steps, timeout, max_memory);
+		interpreter.setPolling(strict_poll, poll_latency);
 		interpreter.runConsole();
+		interpreter.printStats(std::cerr);
+	}
+
+	kmsl::Trace::stop(); // after the interpreter, its threads are done then
+	kmsl::Metrics::unpublish();
+
+	if (recorder)
+	{
+		kmsl::InputState::setRecorder(nullptr);
+		std::cout << recorder->events() << " events recorded (" << recorder->bytes() << " bytes)" << std::endl;
 	}
 	return 0;
 }
\ No newline at end of file
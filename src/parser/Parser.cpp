@@ -108,7 +108,12 @@ namespace kmsl
 			std::unique_ptr<WhileNode> whileNode = parseWhile();
 			return whileNode;
 		}
-		else if (match({ TokenType::BREAK, TokenType::CONTINUE, TokenType::EXIT }).type != TokenType::INVALID)
+		else if (match({ TokenType::ON, TokenType::EVERY }).type != TokenType::INVALID)
+		{
+			std::unique_ptr<TriggerNode> triggerNode = parseTrigger();
+			return triggerNode;
+		}
+		else if (match({ TokenType::BREAK, TokenType::CONTINUE, TokenType::EXIT, TokenType::SYNC, TokenType::FLUSH }).type != TokenType::INVALID)
 		{
 			std::unique_ptr<CommandNode> commandNode(std::make_unique<CommandNode>(current_token_));
 			return commandNode;
@@ -123,7 +128,7 @@ namespace kmsl
 			std::unique_ptr<MouseNode> mouseNode = parseMouse();
 			return mouseNode;
 		}
-		else if (match({ TokenType::TYPE, TokenType::SCROLL }).type != TokenType::INVALID)
+		else if (match({ TokenType::TYPE, TokenType::SCROLL, TokenType::REPLAY, TokenType::WAITUNTIL }).type != TokenType::INVALID)
 		{
 			std::unique_ptr<BinarOpNode> typeNode = parseTypeAndScroll();
 			return typeNode;
@@ -134,18 +139,23 @@ namespace kmsl
 			std::unique_ptr<KeyNode> keyNode(std::make_unique<KeyNode>(token, parseArguments()));
 			return keyNode;
 		}
-		else if (match({ TokenType::WAIT, TokenType::OS, TokenType::DO,TokenType::CREATEFILE, TokenType::REMOVE, TokenType::CREATEDIR }).type != TokenType::INVALID)
+		else if (match({ TokenType::ASYNC }).type != TokenType::INVALID)
+		{
+			std::unique_ptr<AsyncNode> asyncNode = parseAsync();
+			return asyncNode;
+		}
+		else if (match({ TokenType::WAIT, TokenType::WAITKEY, TokenType::OS, TokenType::DO,TokenType::CREATEFILE, TokenType::REMOVE, TokenType::CREATEDIR, TokenType::REMOVETREE, TokenType::CLOSE }).type != TokenType::INVALID)
 		{
 			Token oper = current_token_;
 			std::unique_ptr<UnarOpNode> unarNode(std::make_unique<UnarOpNode>(oper, parseExpression()));
 			return unarNode;
 		}
-		else if (match({ TokenType::WRITEFILE, TokenType::APPENDFILE, TokenType::COPY, TokenType::RENAME }).type != TokenType::INVALID) // Binar
+		else if (match({ TokenType::WRITEFILE, TokenType::APPENDFILE, TokenType::COPY, TokenType::RENAME, TokenType::COPYTREE }).type != TokenType::INVALID) // Binar
 		{
 			std::unique_ptr<BinarOpNode> filesystemNode = parseFileAndDir();
 			return filesystemNode;
 		}
-		else if (match({ TokenType::LPAR, TokenType::STRING, TokenType::INT, TokenType::FLOAT, TokenType::BOOL, TokenType::YEAR, TokenType::MONTH, TokenType::WEEK, TokenType::DAY, TokenType::HOUR, TokenType::MINUTE, TokenType::SECOND, TokenType::MILLI, TokenType::SIN, TokenType::COS, TokenType::TAN, TokenType::ASIN, TokenType::ACOS, TokenType::ATAN, TokenType::ABS, TokenType::RCEIL, TokenType::RFLOOR, TokenType::PI, TokenType::E, TokenType::PHI, TokenType::READFILE, TokenType::EXISTS, TokenType::GETX, TokenType::GETY, TokenType::STATE, TokenType::RANDOM, TokenType::PLUS, TokenType::MINUS, TokenType::LOGICAL_NOT, TokenType::BIT_NOT }).type != TokenType::INVALID)
+		else if (match({ TokenType::LPAR, TokenType::STRING, TokenType::INT, TokenType::FLOAT, TokenType::BOOL, TokenType::YEAR, TokenType::MONTH, TokenType::WEEK, TokenType::DAY, TokenType::HOUR, TokenType::MINUTE, TokenType::SECOND, TokenType::MILLI, TokenType::SIN, TokenType::COS, TokenType::TAN, TokenType::ASIN, TokenType::ACOS, TokenType::ATAN, TokenType::ABS, TokenType::RCEIL, TokenType::RFLOOR, TokenType::PI, TokenType::E, TokenType::PHI, TokenType::READFILE, TokenType::EXISTS, TokenType::OPENREAD, TokenType::READLINE, TokenType::END_OF_FILE, TokenType::AWAIT, TokenType::DONE, TokenType::LISTDIR, TokenType::EXEC, TokenType::EXITCODE, TokenType::GETX, TokenType::GETY, TokenType::STATE, TokenType::RANDOM, TokenType::PLUS, TokenType::MINUS, TokenType::LOGICAL_NOT, TokenType::BIT_NOT }).type != TokenType::INVALID)
 		{
 			pos_--;
 			std::unique_ptr<AstNode> expressionNode = parseExpression();
@@ -239,6 +249,38 @@ namespace kmsl
 		return filesystemNode;
 	}
 
+	std::unique_ptr<AsyncNode> Parser::parseAsync()
+	{
+		Token token = current_token_;
+		std::unique_ptr<AstNode> statement;
+
+		if (match({ TokenType::MOVE, TokenType::DMOVE }).type != TokenType::INVALID)
+			statement = parseMouse();
+		else if (match({ TokenType::TYPE, TokenType::SCROLL, TokenType::REPLAY }).type != TokenType::INVALID)
+			statement = parseTypeAndScroll();
+		else if (match({ TokenType::PRESS }).type != TokenType::INVALID)
+		{
+			Token pressToken = current_token_;
+			statement = std::make_unique<KeyNode>(pressToken, parseArguments());
+		}
+		else if (match({ TokenType::WRITEFILE, TokenType::APPENDFILE, TokenType::COPY, TokenType::RENAME, TokenType::COPYTREE }).type != TokenType::INVALID)
+			statement = parseFileAndDir();
+		else if (match({ TokenType::CREATEFILE, TokenType::REMOVE, TokenType::CREATEDIR, TokenType::REMOVETREE }).type != TokenType::INVALID)
+		{
+			Token oper = current_token_;
+			statement = std::make_unique<UnarOpNode>(oper, parseExpression());
+		}
+		else if (match({ TokenType::EXEC }).type != TokenType::INVALID)
+		{
+			Token exec_token = current_token_;
+			statement = std::make_unique<ExecNode>(exec_token, parseArguments());
+		}
+		else
+			error_handler_.report(ErrorType::SYNTAX_ERROR, "ASYNC works only with MOVE, DMOVE, SCROLL, TYPE, PRESS, REPLAY, EXEC and the file operations", token.pos);
+
+		return std::make_unique<AsyncNode>(token, std::move(statement));
+	}
+
 	std::vector<std::unique_ptr<AstNode>> Parser::parseArguments()
 	{
 		std::vector<std::unique_ptr<AstNode>> arguments;
@@ -411,6 +453,52 @@ namespace kmsl
 		return whileNode;
 	}
 
+	std::unique_ptr<TriggerNode> Parser::parseTrigger()
+	{
+		Token posToken = current_token_;
+
+		if (posToken.type == TokenType::ON)
+		{
+			// KEY is not reserved, so variables called 'key' still work
+			Token key = require({ TokenType::VARIABLE });
+			if (key.type != TokenType::INVALID && key.text != "KEY" && key.text != "key")
+				error_handler_.report(ErrorType::SYNTAX_ERROR, "Expected KEY after ON", key.pos);
+		}
+
+		removeTokensUntil({ TokenType::LINE_END }, { TokenType::LBRACE });
+		std::unique_ptr<AstNode> argumentNode = parseExpression();
+
+		if (require({ TokenType::LBRACE }).type == TokenType::INVALID)
+		{
+			error_handler_.report(ErrorType::SYNTAX_ERROR, "'{}' were forgotten", current_token_.pos - 1);
+
+			return std::make_unique<TriggerNode>(
+				posToken,
+				std::move(argumentNode),
+				std::move(std::unique_ptr<AstNode>())
+			);
+		}
+
+		std::unique_ptr<BlockNode> bodyNode = std::make_unique<BlockNode>();
+
+		while (match({ TokenType::RBRACE }).type == TokenType::INVALID)
+		{
+			std::unique_ptr<AstNode> codeStringNode = parseLine();
+			require({ TokenType::LINE_END });
+
+			if (codeStringNode)
+				bodyNode->addStatement(std::move(codeStringNode));
+		}
+
+		std::unique_ptr<TriggerNode> triggerNode = std::make_unique<TriggerNode>(
+			posToken,
+			std::move(argumentNode),
+			std::move(bodyNode)
+		);
+
+		return triggerNode;
+	}
+
 	std::unique_ptr<AstNode> Parser::parseTerm()
 	{
 		std::unique_ptr<AstNode> node = parseFactor();
@@ -440,14 +528,23 @@ namespace kmsl
 		}
 		else if (match({ TokenType::STRING, TokenType::INT, TokenType::FLOAT, TokenType::BOOL }).type != TokenType::INVALID)
 			return std::make_unique<LiteralNode>(current_token_);
-		else if (match({ TokenType::VARIABLE, TokenType::GETX, TokenType::GETY, TokenType::RANDOM, TokenType::PI, TokenType::E, TokenType::PHI, TokenType::YEAR, TokenType::MONTH, TokenType::WEEK, TokenType::DAY, TokenType::HOUR, TokenType::MINUTE, TokenType::SECOND, TokenType::MILLI }).type != TokenType::INVALID)
+		else if (match({ TokenType::VARIABLE, TokenType::GETX, TokenType::GETY, TokenType::RANDOM, TokenType::EXITCODE, TokenType::PI, TokenType::E, TokenType::PHI, TokenType::YEAR, TokenType::MONTH, TokenType::WEEK, TokenType::DAY, TokenType::HOUR, TokenType::MINUTE, TokenType::SECOND, TokenType::MILLI }).type != TokenType::INVALID)
 			return std::make_unique<VariableNode>(current_token_);
-		else if (match({ TokenType::STATE, TokenType::READFILE,  TokenType::EXISTS, }).type != TokenType::INVALID)
+		else if (match({ TokenType::STATE, TokenType::READFILE,  TokenType::EXISTS, TokenType::OPENREAD, TokenType::READLINE, TokenType::END_OF_FILE, TokenType::AWAIT, TokenType::DONE, TokenType::LISTDIR }).type != TokenType::INVALID)
 		{
 			Token state_token = current_token_;
 			std::unique_ptr<AstNode> node = parseExpression();
 			return std::make_unique<UnarOpNode>(state_token, std::move(node));
 		}
+		else if (match({ TokenType::ASYNC }).type != TokenType::INVALID) // h = ASYNC COPY ...
+			return parseAsync();
+		else if (match({ TokenType::WAITUNTIL }).type != TokenType::INVALID) // ok = WAITUNTIL EXISTS 'lock', 5
+			return parseTypeAndScroll();
+		else if (match({ TokenType::EXEC }).type != TokenType::INVALID)
+		{
+			Token exec_token = current_token_;
+			return std::make_unique<ExecNode>(exec_token, parseArguments());
+		}
 
 		error_handler_.report(ErrorType::SYNTAX_ERROR, "Expectet another value", current_token_.pos);
 		return std::unique_ptr<AstNode>();
@@ -31,12 +31,14 @@ namespace kmsl
 		std::unique_ptr<MouseNode> parseMouse();
 		std::unique_ptr<BinarOpNode> parseTypeAndScroll();
 		std::unique_ptr<BinarOpNode> parseFileAndDir();
+		std::unique_ptr<AsyncNode> parseAsync();
 		std::vector<std::unique_ptr<AstNode>> parseArguments();
 		
 		// constructions
 		std::unique_ptr<IfNode> parseIf();
 		std::unique_ptr<ForNode> parseFor();
 		std::unique_ptr<WhileNode> parseWhile();
+		std::unique_ptr<TriggerNode> parseTrigger(); // ON KEY and EVERY
 
 		// formula
 		std::unique_ptr<AstNode> parseFactor();
@@ -50,8 +52,8 @@ namespace kmsl
 		ErrorHandler& error_handler_;
 
 		std::vector<Token> tokens_;
+		long long pos_; // declared before current_token_, which is initialized from tokens_[pos_]
 		Token current_token_;
-		long long pos_;
 	};
 }
 
@@ -32,6 +32,12 @@ namespace kmsl
 			visit(mouseNode);
 		else if (auto commandNode = dynamic_cast<CommandNode*>(node))
 			visit(commandNode);
+		else if (auto asyncNode = dynamic_cast<AsyncNode*>(node))
+			visit(asyncNode);
+		else if (auto triggerNode = dynamic_cast<TriggerNode*>(node))
+			visit(triggerNode);
+		else if (auto execNode = dynamic_cast<ExecNode*>(node))
+			visit(execNode);
 	}
 
 	void SemanticAnalyzer::visit(BlockNode* node)
@@ -57,6 +63,7 @@ namespace kmsl
 		if (node->token.type != TokenType::GETX &&
 			node->token.type != TokenType::GETY &&
 			node->token.type != TokenType::RANDOM &&
+			node->token.type != TokenType::EXITCODE &&
 			node->token.type != TokenType::PI &&
 			node->token.type != TokenType::E &&
 			node->token.type != TokenType::PHI &&
@@ -94,6 +101,7 @@ namespace kmsl
 			op == TokenType::LOGICAL_NOT ||
 			op == TokenType::BIT_NOT ||
 			op == TokenType::WAIT ||
+			op == TokenType::WAITKEY ||
 			op == TokenType::STATE ||
 			op == TokenType::OS ||
 			op == TokenType::DO ||
@@ -110,7 +118,15 @@ namespace kmsl
 			op == TokenType::CREATEFILE ||
 			op == TokenType::REMOVE ||
 			op == TokenType::EXISTS ||
-			op == TokenType::CREATEDIR)
+			op == TokenType::OPENREAD ||
+			op == TokenType::READLINE ||
+			op == TokenType::END_OF_FILE ||
+			op == TokenType::CLOSE ||
+			op == TokenType::AWAIT ||
+			op == TokenType::DONE ||
+			op == TokenType::CREATEDIR ||
+			op == TokenType::REMOVETREE ||
+			op == TokenType::LISTDIR)
 			visitNode(node->operand.get());
 		else if (op == TokenType::INPUT)
 		{
@@ -239,13 +255,26 @@ namespace kmsl
 		case TokenType::NOT_EQUALS:
 		case TokenType::TYPE:
 		case TokenType::SCROLL:
+		case TokenType::REPLAY:
 		case TokenType::WRITEFILE:
 		case TokenType::APPENDFILE:
 		case TokenType::COPY:
 		case TokenType::RENAME:
+		case TokenType::COPYTREE:
 			visitNode(node->leftOperand.get());
 			visitNode(node->rightOperand.get());
 			break;
+		case TokenType::WAITUNTIL:
+		{
+			DataType conditionType = determineType(node->leftOperand.get()); // STATE, EXISTS etc. are UNDEFINED here and checked at runtime
+			if (conditionType != DataType::BOOL && conditionType != DataType::UNDEFINED)
+				error_handler_.report(ErrorType::SEMANTIC_ERROR, "The condition in 'waituntil' should be a boolean expression", node->op.pos + 1);
+
+			DataType timeoutType = node->rightOperand ? determineType(node->rightOperand.get()) : DataType::INT;
+			if (timeoutType == DataType::STRING || timeoutType == DataType::BOOL)
+				error_handler_.report(ErrorType::SEMANTIC_ERROR, "The timeout of 'waituntil' should be a number", node->op.pos + 1);
+			break;
+		}
 
 		}
 	}
@@ -309,6 +338,33 @@ namespace kmsl
 		}
 	}
 
+	void SemanticAnalyzer::visit(AsyncNode* node)
+	{
+		visitNode(node->statement.get());
+	}
+
+	void SemanticAnalyzer::visit(TriggerNode* node)
+	{
+		bool wasInsideLoop = inside_loop_;
+		inside_loop_ = false; // the handler runs on its own, not inside the loop around it
+
+		DataType type = determineType(node->argumentNode.get()); // UNDEFINED is checked at runtime
+		if (node->token.type == TokenType::ON && type != DataType::STRING && type != DataType::UNDEFINED)
+			error_handler_.report(ErrorType::SEMANTIC_ERROR, "The key in 'on key' should be a string", node->token.pos + 2);
+		else if (node->token.type == TokenType::EVERY && type != DataType::INT && type != DataType::FLOAT && type != DataType::UNDEFINED)
+			error_handler_.report(ErrorType::SEMANTIC_ERROR, "The interval in 'every' should be a number", node->token.pos + 1);
+
+		if (node->bodyNode.get()) visit(dynamic_cast<BlockNode*>(node->bodyNode.get()));
+
+		inside_loop_ = wasInsideLoop;
+	}
+
+	void SemanticAnalyzer::visit(ExecNode* node)
+	{
+		for (auto& argument : node->argumentNodes)
+			visitNode(argument.get());
+	}
+
 	DataType SemanticAnalyzer::determineType(AstNode* node)
 	{
 		if (auto literalNode = dynamic_cast<LiteralNode*>(node))
@@ -332,6 +388,16 @@ namespace kmsl
 			visit(binaryOpNode);
 			return determineBinaryOpType(binaryOpNode);
 		}
+		else if (auto asyncNode = dynamic_cast<AsyncNode*>(node))
+		{
+			visit(asyncNode);
+			return DataType::INT; // the handle
+		}
+		else if (auto execNode = dynamic_cast<ExecNode*>(node))
+		{
+			visit(execNode);
+			return DataType::STRING; // the output
+		}
 		return DataType::UNDEFINED;
 	}
 
@@ -367,6 +433,7 @@ namespace kmsl
 		case TokenType::GREATER_THAN_OR_EQUAL:
 		case TokenType::EQUALS:
 		case TokenType::NOT_EQUALS:
+		case TokenType::WAITUNTIL: // true if the condition came true in time
 			return DataType::BOOL;
 		default:
 			return DataType::UNDEFINED;
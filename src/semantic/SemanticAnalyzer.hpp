@@ -2,6 +2,7 @@
 
 #include <memory>
 #include <stdexcept>
+#include <algorithm>
 
 #include "../AST/ast.hpp"
 #include "SymbolTable.hpp"
@@ -30,6 +31,9 @@ namespace kmsl
 		void visit(KeyNode* node);
 		void visit(MouseNode* node);
 		void visit(CommandNode* node);
+		void visit(AsyncNode* node);
+		void visit(TriggerNode* node);
+		void visit(ExecNode* node);
 
 		DataType determineType(AstNode* node);
 		DataType determineBinaryOpType(BinarOpNode* node);
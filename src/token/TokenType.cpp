@@ -2,7 +2,7 @@
 
 namespace kmsl
 {
-    std::vector<std::pair<std::string, TokenType>> token_list = {
+    const std::vector<std::pair<std::string, TokenType>> token_list = {
         {"(move|MOVE)\\b", TokenType::MOVE},
         {"(dmove|DMOVE)\\b", TokenType::DMOVE},
         {"(scroll|SCROLL)\\b", TokenType::SCROLL},
@@ -11,7 +11,13 @@ namespace kmsl
         {"(hold|HOLD)\\b", TokenType::HOLD},
         {"(release|RELEASE)\\b", TokenType::RELEASE},
         {"(state|STATE)\\b", TokenType::STATE},
+        {"(async|ASYNC)\\b", TokenType::ASYNC},
+        {"(sync|SYNC)\\b", TokenType::SYNC},
+        {"(replay|REPLAY)\\b", TokenType::REPLAY},
+        {"(flush|FLUSH)\\b", TokenType::FLUSH},
         {"(wait|WAIT)\\b", TokenType::WAIT},
+        {"(waitkey|WAITKEY)\\b", TokenType::WAITKEY},
+        {"(waituntil|WAITUNTIL)\\b", TokenType::WAITUNTIL},
         {"(getx|GETX)\\b", TokenType::GETX},
         {"(gety|GETY)\\b", TokenType::GETY},
         {"(year|YEAR)\\b", TokenType::YEAR},
@@ -41,10 +47,21 @@ namespace kmsl
         {"(copy|COPY)\\b", TokenType::COPY},
         {"(rename|RENAME)\\b", TokenType::RENAME},
         {"(exists|EXISTS)\\b", TokenType::EXISTS},
+        {"(openread|OPENREAD)\\b", TokenType::OPENREAD},
+        {"(readline|READLINE)\\b", TokenType::READLINE},
+        {"(eof|EOF)\\b", TokenType::END_OF_FILE},
+        {"(close|CLOSE)\\b", TokenType::CLOSE},
+        {"(await|AWAIT)\\b", TokenType::AWAIT},
+        {"(done|DONE)\\b", TokenType::DONE},
+        {"(copytree|COPYTREE)\\b", TokenType::COPYTREE},
+        {"(removetree|REMOVETREE)\\b", TokenType::REMOVETREE},
+        {"(listdir|LISTDIR)\\b", TokenType::LISTDIR},
         {"(createdir|CREATEDIR)\\b", TokenType::CREATEDIR},
         {"(milli|MILLI)\\b", TokenType::MILLI},
         {"(do|DO)\\b", TokenType::DO},
         {"(os|OS)\\b", TokenType::OS},
+        {"(exec|EXEC)\\b", TokenType::EXEC},
+        {"(exitcode|EXITCODE)\\b", TokenType::EXITCODE},
         {"(random|RANDOM)\\b", TokenType::RANDOM},
         {"!!", TokenType::EXIT},
         {"(\\n|\\r)", TokenType::LINE_END},
@@ -96,6 +113,8 @@ namespace kmsl
         {"(else|ELSE)\\b", TokenType::ELSE},
         {"(while|WHILE)\\b", TokenType::WHILE},
         {"(for|FOR)\\b", TokenType::FOR},
+        {"(on|ON)\\b", TokenType::ON},
+        {"(every|EVERY)\\b", TokenType::EVERY},
         {"(break|BREAK)\\b", TokenType::BREAK},
         {"(continue|CONTINUE)\\b", TokenType::CONTINUE},
         {"(print|PRINT)\\b", TokenType::PRINT},
@@ -10,9 +10,11 @@ namespace kmsl
 		/* Constructions */
 		IF, ELSE,
 		WHILE, FOR, BREAK, CONTINUE,
+		ON, EVERY,
 
 		/* Basic Functions */
 		WAIT, EXIT, RANDOM, OS, DO, PRINT, INPUT,
+		EXEC, EXITCODE,
 
 		/* Time */
 		YEAR, MONTH, WEEK, DAY, HOUR, MINUTE, SECOND, MILLI,
@@ -24,9 +26,13 @@ namespace kmsl
 		READFILE, WRITEFILE, APPENDFILE, CREATEFILE, // file operations
 		CREATEDIR, // dir operations
 		REMOVE, COPY, RENAME, EXISTS, // dir and file operations
+		FLUSH, // writes the buffered files
+		OPENREAD, READLINE, END_OF_FILE, CLOSE, // line by line reading
+		AWAIT, DONE, // ASYNC file operations
+		COPYTREE, REMOVETREE, LISTDIR, // whole dirs
 
 		/* Mouse & Keyboard */
-		MOVE, DMOVE, SCROLL, TYPE, PRESS, HOLD, RELEASE, GETX, GETY, STATE,
+		MOVE, DMOVE, SCROLL, TYPE, PRESS, HOLD, RELEASE, GETX, GETY, STATE, WAITKEY, WAITUNTIL, ASYNC, SYNC, REPLAY,
 		
 		/* Operators */
 		PLUS, MINUS, MULTIPLY, DIVIDE, FLOOR, MODULO, ROOT, LOG, POWER,
@@ -54,5 +60,5 @@ namespace kmsl
 		COMMA,
 	};
 
-	extern std::vector<std::pair<std::string, TokenType>> token_list;
+	extern const std::vector<std::pair<std::string, TokenType>> token_list; // only read, the lexers of all threads share it
 }
\ No newline at end of file